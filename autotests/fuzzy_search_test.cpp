@@ -0,0 +1,58 @@
+#include <QTest>
+
+#include "fuzzy_search.h"
+
+
+class FuzzySearchTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void substringDistance_data();
+    void substringDistance();
+    void similarity();
+};
+
+void FuzzySearchTest::substringDistance_data()
+{
+    QTest::addColumn<QString>("word");
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<qsizetype>("distance");
+
+    QTest::newRow("equal") << QStringLiteral("zotero") << QStringLiteral("zotero") << qsizetype(0);
+    QTest::newRow("substring") << QStringLiteral("zotero") << QStringLiteral("the zotero library") << qsizetype(0);
+    QTest::newRow("substitution") << QStringLiteral("zotaro") << QStringLiteral("my zotero") << qsizetype(1);
+    QTest::newRow("insertion") << QStringLiteral("zoteero") << QStringLiteral("zotero notes") << qsizetype(1);
+    QTest::newRow("deletion") << QStringLiteral("zoero") << QStringLiteral("a zotero") << qsizetype(1);
+    QTest::newRow("transposition") << QStringLiteral("retreival") << QStringLiteral("retrieval augmented") << qsizetype(2);
+    QTest::newRow("partial overlap") << QStringLiteral("kitten") << QStringLiteral("sitting") << qsizetype(2);
+    QTest::newRow("no overlap") << QStringLiteral("neural") << QStringLiteral("networks") << qsizetype(4);
+    QTest::newRow("longer than text") << QStringLiteral("longword") << QStringLiteral("short") << qsizetype(6);
+    QTest::newRow("empty word") << QString() << QStringLiteral("abc") << qsizetype(0);
+    QTest::newRow("empty text") << QStringLiteral("abc") << QString() << qsizetype(3);
+    QTest::newRow("case-sensitive") << QStringLiteral("a") << QStringLiteral("A") << qsizetype(1);
+}
+
+void FuzzySearchTest::substringDistance()
+{
+    QFETCH(QString, word);
+    QFETCH(QString, text);
+    QFETCH(qsizetype, distance);
+
+    QCOMPARE(FuzzySearch::substringDistance(word, text), distance);
+}
+
+void FuzzySearchTest::similarity()
+{
+    const QStringList words = {QStringLiteral("retrieval"), QStringLiteral("augmented")};
+    QCOMPARE(FuzzySearch::similarity(words, QStringLiteral("Retrieval-Augmented Generation")), 1.0);
+    // one typo in each word, which tolerates two in nine characters
+    QCOMPARE(FuzzySearch::similarity(words, QStringLiteral("Retreval-Augmentd Generation")), 1.0 - 2.0 / 18.0);
+    // four typos are too many for "retrieval"
+    QCOMPARE(FuzzySearch::similarity({QStringLiteral("retrieval")}, QStringLiteral("rtrvl")), 0.0);
+    QCOMPARE(FuzzySearch::similarity({}, QStringLiteral("text")), 0.0);
+}
+
+QTEST_GUILESS_MAIN(FuzzySearchTest)
+
+#include "fuzzy_search_test.moc"
@@ -0,0 +1,68 @@
+#include <QTest>
+#include <string>
+
+#include "zotero_html.h"
+
+
+class ZoteroHtmlTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void appendText_data();
+    void appendText();
+    void appendsAfterSpace();
+};
+
+void ZoteroHtmlTest::appendText_data()
+{
+    QTest::addColumn<QByteArray>("html");
+    QTest::addColumn<QByteArray>("text");
+
+    QTest::newRow("words") << QByteArray("<p>first  <strong>sec</strong>ond</p><p>third</p>") << QByteArray("first second third");
+    QTest::newRow("lone <") << QByteArray("p < 0.05") << QByteArray("p < 0.05");
+    QTest::newRow("< before a digit") << QByteArray("1<2") << QByteArray("1<2");
+    QTest::newRow("< at the end") << QByteArray("a <") << QByteArray("a <");
+    QTest::newRow("quoted >") << QByteArray("<span title=\"a>b\">text</span>") << QByteArray("text");
+    QTest::newRow("unterminated double quote") << QByteArray("before<span title=\"x>after") << QByteArray("before");
+    QTest::newRow("unterminated single quote") << QByteArray("before<span title='x>after") << QByteArray("before");
+    QTest::newRow("unterminated comment") << QByteArray("before<!-- after") << QByteArray("before");
+    QTest::newRow("script") << QByteArray("<script>let p = '<p>';</script>text") << QByteArray("text");
+    QTest::newRow("named references") << QByteArray("AT&amp;T&nbsp;&ldquo;x&rdquo;") << QByteArray("AT&T “x”");
+    QTest::newRow("unknown references") << QByteArray("AT&T &foo; &amp") << QByteArray("AT&T &foo; &amp");
+    QTest::newRow("hex reference") << QByteArray("caf&#xE9;") << QByteArray("café");
+    QTest::newRow("reference without ;") << QByteArray("&#65 b") << QByteArray("A b");
+    QTest::newRow("empty hex reference") << QByteArray("&#x;") << QByteArray("&#x;");
+    QTest::newRow("empty decimal reference") << QByteArray("&#;") << QByteArray("&#;");
+    QTest::newRow("astral reference") << QByteArray("&#x1F600;") << QByteArray("\xF0\x9F\x98\x80");
+    QTest::newRow("high surrogate") << QByteArray("a&#xD800;b") << QByteArray("a\xEF\xBF\xBD" "b");
+    QTest::newRow("low surrogate") << QByteArray("&#57343;") << QByteArray("\xEF\xBF\xBD");
+    QTest::newRow("beyond Unicode") << QByteArray("&#x110000;") << QByteArray("\xEF\xBF\xBD");
+    QTest::newRow("space references") << QByteArray("a&#32;b&#xA0;c&#9;d") << QByteArray("a b c d");
+    QTest::newRow("data URI attribute") << QByteArray("<p>see<img src=\"data:image/png;base64,iVBORw0KGgo=\">figure</p>")
+                                        << QByteArray("see figure");
+    QTest::newRow("data URI text") << QByteArray("see data:image/png;base64,iVBORw0KGgo= figure") << QByteArray("see figure");
+}
+
+void ZoteroHtmlTest::appendText()
+{
+    QFETCH(QByteArray, html);
+    QFETCH(QByteArray, text);
+
+    std::string actual;
+    ZoteroHtml::appendText(std::string_view(html.constData(), html.size()), actual);
+    QCOMPARE(QByteArray::fromStdString(actual), text);
+}
+
+void ZoteroHtmlTest::appendsAfterSpace()
+{
+    std::string text = "first";
+    ZoteroHtml::appendText("<p>second</p>", text);
+    QCOMPARE(QByteArray::fromStdString(text), QByteArray("first second"));
+    ZoteroHtml::appendText("<p></p>", text);
+    QCOMPARE(QByteArray::fromStdString(text), QByteArray("first second"));
+}
+
+QTEST_GUILESS_MAIN(ZoteroHtmlTest)
+
+#include "zotero_html_test.moc"
@@ -0,0 +1,131 @@
+#include <QTest>
+#include <stdexcept>
+
+#include "zotero_json.h"
+
+
+namespace
+{
+QString toQString(const std::string_view text)
+{
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
+
+QStringList parseStringArray(const std::string_view json)
+{
+    QStringList values;
+    ZoteroJson::parseStringArray(json, [&values](const std::string_view value) { values << toQString(value); });
+    return values;
+}
+
+QStringList parseStringMap(const std::string_view json)
+{
+    QStringList fields;
+    ZoteroJson::parseStringMap(json, [&fields](const std::string_view name, const std::string_view value)
+    {
+        fields << toQString(name) + QLatin1Char('=') + toQString(value);
+    });
+    return fields;
+}
+} // namespace
+
+
+class ZoteroJsonTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void stringArray();
+    void stringArrayConvertsScalars();
+    void stringMapSkipsNull();
+    void stringMapConvertsScalars();
+    void attachments();
+    void rejectsUnexpectedShapes_data();
+    void rejectsUnexpectedShapes();
+};
+
+void ZoteroJsonTest::stringArray()
+{
+    QCOMPARE(parseStringArray(R"(["a", "b \"c\"", "é"])"),
+             QStringList({QStringLiteral("a"), QStringLiteral("b \"c\""), QStringLiteral("é")}));
+    QCOMPARE(parseStringArray("[]"), QStringList());
+}
+
+void ZoteroJsonTest::stringArrayConvertsScalars()
+{
+    QCOMPARE(parseStringArray(R"(["a", null, 3, -4, true, 1.5])"),
+             QStringList({QStringLiteral("a"), QString(), QStringLiteral("3"), QStringLiteral("-4"), QStringLiteral("true"),
+                          QStringLiteral("1.5")}));
+}
+
+void ZoteroJsonTest::stringMapSkipsNull()
+{
+    QCOMPARE(parseStringMap(R"({"title": "T", "extra": null, "url": ""})"),
+             QStringList({QStringLiteral("title=T"), QStringLiteral("url=")}));
+    QCOMPARE(parseStringMap(R"({"extra": null})"), QStringList());
+}
+
+void ZoteroJsonTest::stringMapConvertsScalars()
+{
+    QCOMPARE(parseStringMap(R"({"volume": 12, "pages": 1.25, "flag": false})"),
+             QStringList({QStringLiteral("volume=12"), QStringLiteral("pages=1.25"), QStringLiteral("flag=false")}));
+}
+
+void ZoteroJsonTest::attachments()
+{
+    QStringList events;
+    ZoteroJson::parseAttachments(R"([{"key": "K1", "path": null, "size": 3}, {"key": "K2"}])",
+                                 [&events]() { events << QStringLiteral("attachment"); },
+                                 [&events](const std::string_view name, const std::string_view value)
+                                 {
+                                     events << toQString(name) + QLatin1Char('=') + toQString(value);
+                                 });
+    QCOMPARE(events, QStringList({QStringLiteral("attachment"), QStringLiteral("key=K1"), QStringLiteral("path="),
+                                  QStringLiteral("size=3"), QStringLiteral("attachment"), QStringLiteral("key=K2")}));
+}
+
+void ZoteroJsonTest::rejectsUnexpectedShapes_data()
+{
+    QTest::addColumn<int>("shape");
+    QTest::addColumn<QByteArray>("json");
+
+    // 0: array of strings, 1: object of strings, 2: array of attachments
+    QTest::newRow("array: malformed") << 0 << QByteArray(R"(["a")");
+    QTest::newRow("array: empty input") << 0 << QByteArray();
+    QTest::newRow("array: null") << 0 << QByteArray("null");
+    QTest::newRow("array: object") << 0 << QByteArray(R"({"a": "b"})");
+    QTest::newRow("array: nested array") << 0 << QByteArray(R"([["a"]])");
+    QTest::newRow("array: nested object") << 0 << QByteArray(R"([{"a": "b"}])");
+    QTest::newRow("map: null") << 1 << QByteArray("null");
+    QTest::newRow("map: array") << 1 << QByteArray(R"(["a"])");
+    QTest::newRow("map: nested object") << 1 << QByteArray(R"({"a": {"b": "c"}})");
+    QTest::newRow("map: nested array") << 1 << QByteArray(R"({"a": ["b"]})");
+    QTest::newRow("attachments: strings") << 2 << QByteArray(R"(["a"])");
+    QTest::newRow("attachments: nested arrays") << 2 << QByteArray(R"([["a"]])");
+    QTest::newRow("attachments: nested field") << 2 << QByteArray(R"([{"a": {"b": "c"}}])");
+}
+
+void ZoteroJsonTest::rejectsUnexpectedShapes()
+{
+    QFETCH(int, shape);
+    QFETCH(QByteArray, json);
+
+    const std::string_view view(json.constData(), json.size());
+    const auto ignoreField = [](std::string_view, std::string_view) {};
+    switch (shape)
+    {
+    case 0:
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, ZoteroJson::parseStringArray(view, [](std::string_view) {}));
+        break;
+    case 1:
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, ZoteroJson::parseStringMap(view, ignoreField));
+        break;
+    default:
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, ZoteroJson::parseAttachments(view, []() {}, ignoreField));
+        break;
+    }
+}
+
+QTEST_GUILESS_MAIN(ZoteroJsonTest)
+
+#include "zotero_json_test.moc"
@@ -0,0 +1,307 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "index.h"
+#include "library_generator.h"
+#include "stats.h"
+#include "trace.h"
+#include "zotero.h"
+#include "zotero_html.h"
+
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(const Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template <typename Work>
+double timeMs(Work&& work)
+{
+    const auto start = Clock::now();
+    work();
+    return elapsedMs(start);
+}
+
+// nearest-rank percentile of sorted @p values
+double percentile(const std::vector<double>& values, const double p)
+{
+    if (values.empty())
+        return 0.0;
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+    return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+}
+
+/// Queries resembling what users type into KRunner, drawn from the generator's vocabulary
+class QueryMix
+{
+public:
+    explicit QueryMix(const std::uint32_t seed) : m_random(seed) {}
+
+    // the first few letters of a word, as while typing
+    QString prefix() { return word().left(3 + pick(3)); }
+    // a few complete words
+    QString words()
+    {
+        QStringList words;
+        for (int i = 1 + pick(3); i > 0; --i)
+            words.append(word());
+        return words.join(QLatin1Char(' '));
+    }
+    QString author()
+    {
+        const auto& names = LibraryGenerator::lastNames();
+        return names[pick(static_cast<int>(names.size()))] + QLatin1Char(' ') + word().left(4);
+    }
+    // one substituted letter, so only the typo-tolerant fallback finds the word
+    QString typo()
+    {
+        QString typo;
+        do
+            typo = word();
+        while (typo.size() < 6);
+        const auto i = 1 + pick(static_cast<int>(typo.size()) - 2);
+        typo[i] = typo[i] == QLatin1Char('x') ? QLatin1Char('q') : QLatin1Char('x');
+        return typo;
+    }
+    QString miss() { return QStringLiteral("zzqx%1").arg(pick(100000)); }
+
+private:
+    std::mt19937 m_random;
+
+    int pick(const int size) { return std::uniform_int_distribution<>(0, size - 1)(m_random); }
+    QString word()
+    {
+        const auto& vocabulary = LibraryGenerator::vocabulary();
+        return vocabulary[pick(static_cast<int>(vocabulary.size()))];
+    }
+};
+
+json searchStats(std::vector<double>& latencies, const std::size_t hits)
+{
+    std::ranges::sort(latencies);
+    return {{"queries", latencies.size()},
+            {"mean_hits", latencies.empty() ? 0.0 : static_cast<double>(hits) / static_cast<double>(latencies.size())},
+            {"p50_ms", percentile(latencies, 50)},
+            {"p90_ms", percentile(latencies, 90)},
+            {"p99_ms", percentile(latencies, 99)},
+            {"max_ms", latencies.empty() ? 0.0 : latencies.back()}};
+}
+
+json benchmarkSearch(const Index& index, const int queries, const std::uint32_t seed)
+{
+    QueryMix mix(seed);
+    const std::vector<std::pair<const char*, std::function<QString()>>> kinds = {
+        {"prefix", [&mix]() { return mix.prefix(); }},
+        {"words", [&mix]() { return mix.words(); }},
+        {"author", [&mix]() { return mix.author(); }},
+        {"typo", [&mix]() { return mix.typo(); }},
+        {"miss", [&mix]() { return mix.miss(); }},
+    };
+
+    json result;
+    for (const auto& [name, next] : kinds)
+    {
+        std::vector<double> latencies;
+        std::size_t hits = 0;
+        for (int i = 0; i < queries; ++i)
+        {
+            // every query is measured cold, the typing benchmark below covers the cache
+            index.clearSearchCache();
+            QString query = next();
+            const auto start = Clock::now();
+            hits += index.search(std::move(query)).hits.size();
+            latencies.push_back(elapsedMs(start));
+        }
+        result[name] = searchStats(latencies, hits);
+    }
+
+    // a query session: every keystroke of a few words, like KRunner sends them
+    std::vector<double> latencies;
+    std::size_t hits = 0;
+    for (int i = 0; i < std::max(1, queries / 10); ++i)
+    {
+        index.clearSearchCache();
+        const QString typed = mix.words();
+        for (qsizetype length = 1; length <= typed.size(); ++length)
+        {
+            const auto start = Clock::now();
+            hits += index.search(typed.left(length)).hits.size();
+            latencies.push_back(elapsedMs(start));
+        }
+    }
+    result["typing"] = searchStats(latencies, hits);
+    return result;
+}
+
+// plain-text extraction of generated HTML notes adding up to @p megabytes
+json benchmarkNotes(const double megabytes, const std::uint32_t seed)
+{
+    const auto notes = LibraryGenerator::notes(static_cast<qint64>(megabytes * 1024 * 1024), seed);
+    std::size_t bytesIn = 0;
+    std::size_t bytesOut = 0;
+    std::string text;
+    const double ms = timeMs([&]()
+    {
+        for (const std::string& note : notes)
+        {
+            text.clear();
+            ZoteroHtml::appendText(note, text);
+            bytesIn += note.size();
+            bytesOut += text.size();
+        }
+    });
+    return {{"notes", notes.size()},
+            {"bytes_in", bytesIn},
+            {"bytes_out", bytesOut},
+            {"ms", ms},
+            {"mb_per_s", ms > 0.0 ? static_cast<double>(bytesIn) / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0}};
+}
+
+std::optional<json> benchmarkLibrary(const QString& dir, LibraryOptions options, const int queries, const double changed)
+{
+    const QString zoteroPath = dir + QStringLiteral("/zotero-%1.sqlite").arg(options.items);
+    const QString indexPath = dir + QStringLiteral("/index-%1.sqlite").arg(options.items);
+    // a library that was kept from an earlier run is generated again
+    QFile::remove(zoteroPath);
+    for (const auto& suffix : {QStringLiteral(""), QStringLiteral("-wal"), QStringLiteral("-shm"), QStringLiteral(".items")})
+    {
+        QFile::remove(indexPath + suffix);
+    }
+    json result = {{"items", options.items}, {"seed", options.seed}};
+    Stats::reset();
+
+    std::cerr << "Generating " << options.items << " items..." << std::endl;
+    bool generated = false;
+    result["generate_ms"] = timeMs([&]() { generated = LibraryGenerator::generate(zoteroPath, options); });
+    if (!generated)
+        return std::nullopt;
+    result["zotero_bytes"] = QFile(zoteroPath).size();
+
+    const Zotero zotero(zoteroPath);
+    std::size_t decoded = 0;
+    const double decodeMs = timeMs([&]()
+    {
+        for ([[maybe_unused]] const auto&& item : zotero.items())
+        {
+            ++decoded;
+        }
+    });
+    result["zotero_items"] = {{"ms", decodeMs}, {"items", decoded}};
+
+    const Index index(indexPath, zotero);
+    if (!index.setup())
+        return std::nullopt;
+    result["update_full_ms"] = timeMs([&]() { index.update(true); });
+    result["update_unchanged_ms"] = timeMs([&]() { index.update(); });
+    const int touched = std::max(1, static_cast<int>(options.items * changed));
+    if (!LibraryGenerator::touch(zoteroPath, touched, options.seed + 1))
+        return std::nullopt;
+    result["update_incremental"] = {{"changed", touched}, {"ms", timeMs([&]() { index.update(); })}};
+    result["index_bytes"] = QFile(indexPath).size();
+
+    std::cerr << "Searching..." << std::endl;
+    result["search"] = benchmarkSearch(index, queries, options.seed + 2);
+    // where the time went, as recorded by the runner's own instrumentation
+    result["stats"] = Stats::toJson();
+    return result;
+}
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("krunner_zotero_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Benchmarks extraction, indexing and search on synthetic Zotero libraries."));
+    parser.addHelpOption();
+    const QCommandLineOption itemsOption(QStringLiteral("items"), QStringLiteral("Comma-separated library sizes."), QStringLiteral("counts"),
+                                         QStringLiteral("1000,10000,50000"));
+    const QCommandLineOption queriesOption(QStringLiteral("queries"), QStringLiteral("Queries per query kind."), QStringLiteral("count"),
+                                           QStringLiteral("200"));
+    const QCommandLineOption changedOption(QStringLiteral("changed"), QStringLiteral("Share of items changed before the incremental update."),
+                                           QStringLiteral("share"), QStringLiteral("0.01"));
+    const QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of the generated libraries and queries."), QStringLiteral("seed"),
+                                        QStringLiteral("42"));
+    const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Write the JSON report to this file instead of stdout."),
+                                          QStringLiteral("file"));
+    const QCommandLineOption keepOption(QStringLiteral("keep"), QStringLiteral("Generate into this directory and keep the databases."),
+                                        QStringLiteral("dir"));
+    const QCommandLineOption traceOption(QStringLiteral("trace"), QStringLiteral("Write a Chrome trace of the whole run to this file."),
+                                         QStringLiteral("file"));
+    const QCommandLineOption notesOption(QStringLiteral("note-mb"), QStringLiteral("Megabytes of HTML notes to extract plain text from."),
+                                         QStringLiteral("size"), QStringLiteral("64"));
+    const QCommandLineOption verboseOption(QStringLiteral("verbose"), QStringLiteral("Show the log output of the runner."));
+    parser.addOptions({itemsOption, queriesOption, changedOption, seedOption, notesOption, outputOption, keepOption, traceOption, verboseOption});
+    parser.process(app);
+
+    if (!parser.isSet(verboseOption))
+    {
+        QLoggingCategory::setFilterRules(QStringLiteral("krunner-zotero/*.debug=false\nkrunner-zotero/*.info=false"));
+    }
+
+    QTemporaryDir tempDir;
+    const QString dir = parser.isSet(keepOption) ? parser.value(keepOption) : tempDir.path();
+    if (parser.isSet(keepOption) ? !QDir().mkpath(dir) : !tempDir.isValid())
+    {
+        std::cerr << "Failed to create directory " << dir.toStdString() << std::endl;
+        return 1;
+    }
+
+    if (parser.isSet(traceOption) && !Trace::start(parser.value(traceOption)))
+    {
+        return 1;
+    }
+
+    json report = {{"version", CMAKE_PROJECT_VERSION}, {"libraries", json::array()}};
+    for (const QString& count : parser.value(itemsOption).split(QLatin1Char(','), Qt::SkipEmptyParts))
+    {
+        LibraryOptions options;
+        options.items = count.toInt();
+        options.seed = parser.value(seedOption).toUInt();
+        const auto result = benchmarkLibrary(dir, options, parser.value(queriesOption).toInt(), parser.value(changedOption).toDouble());
+        if (!result.has_value())
+        {
+            std::cerr << "Benchmark of " << options.items << " items failed" << std::endl;
+            return 1;
+        }
+        report["libraries"].push_back(result.value());
+    }
+    std::cerr << "Extracting notes..." << std::endl;
+    report["notes"] = benchmarkNotes(parser.value(notesOption).toDouble(), parser.value(seedOption).toUInt());
+    Trace::stop();
+
+    const std::string output = report.dump(2);
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            std::cerr << "Failed to write " << parser.value(outputOption).toStdString() << std::endl;
+            return 1;
+        }
+        file.write(output.data(), static_cast<qint64>(output.size()));
+    }
+    else
+    {
+        std::cout << output << std::endl;
+    }
+    return 0;
+}
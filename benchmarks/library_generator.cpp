@@ -0,0 +1,609 @@
+#include "library_generator.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimeZone>
+#include <QUuid>
+#include <QVariant>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+namespace GeneratorSQL
+{
+// the tables and columns of the Zotero 7 schema that the item and change mark queries read
+const std::array createTables = {
+    QStringLiteral("CREATE TABLE libraries (libraryID INTEGER PRIMARY KEY, type TEXT NOT NULL, editable INT NOT NULL, filesEditable INT NOT NULL, version INT NOT NULL DEFAULT 0, storageVersion INT NOT NULL DEFAULT 0, lastSync INT NOT NULL DEFAULT 0, archived INT NOT NULL DEFAULT 0)"),
+    QStringLiteral("CREATE TABLE itemTypes (itemTypeID INTEGER PRIMARY KEY, typeName TEXT, templateItemTypeID INT, display INT DEFAULT 1)"),
+    QStringLiteral("CREATE TABLE items (itemID INTEGER PRIMARY KEY, itemTypeID INT NOT NULL, dateAdded TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, dateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, clientDateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, libraryID INT NOT NULL, key TEXT NOT NULL, version INT NOT NULL DEFAULT 0, synced INT NOT NULL DEFAULT 0, UNIQUE (libraryID, key))"),
+    QStringLiteral("CREATE TABLE fields (fieldID INTEGER PRIMARY KEY, fieldName TEXT, fieldFormatID INT)"),
+    QStringLiteral("CREATE TABLE itemDataValues (valueID INTEGER PRIMARY KEY, value UNIQUE)"),
+    QStringLiteral("CREATE TABLE itemData (itemID INT, fieldID INT, valueID, PRIMARY KEY (itemID, fieldID))"),
+    QStringLiteral("CREATE INDEX itemData_fieldID ON itemData(fieldID)"),
+    QStringLiteral("CREATE TABLE itemNotes (itemID INTEGER PRIMARY KEY, parentItemID INT, note TEXT, title TEXT)"),
+    QStringLiteral("CREATE INDEX itemNotes_parentItemID ON itemNotes(parentItemID)"),
+    QStringLiteral("CREATE TABLE itemAttachments (itemID INTEGER PRIMARY KEY, parentItemID INT, linkMode INT, contentType TEXT, charsetID INT, path TEXT, syncState INT DEFAULT 0, storageModTime INT, storageHash TEXT, lastProcessedModificationTime INT)"),
+    QStringLiteral("CREATE INDEX itemAttachments_parentItemID ON itemAttachments(parentItemID)"),
+    QStringLiteral("CREATE TABLE tags (tagID INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE)"),
+    QStringLiteral("CREATE TABLE itemTags (itemID INT NOT NULL, tagID INT NOT NULL, type INT NOT NULL, PRIMARY KEY (itemID, tagID))"),
+    QStringLiteral("CREATE INDEX itemTags_tagID ON itemTags(tagID)"),
+    QStringLiteral("CREATE TABLE creators (creatorID INTEGER PRIMARY KEY, firstName TEXT, lastName TEXT, fieldMode INT, UNIQUE (lastName, firstName, fieldMode))"),
+    QStringLiteral("CREATE TABLE creatorTypes (creatorTypeID INTEGER PRIMARY KEY, creatorType TEXT)"),
+    QStringLiteral("CREATE TABLE itemCreators (itemID INT NOT NULL, creatorID INT NOT NULL, creatorTypeID INT NOT NULL DEFAULT 1, orderIndex INT NOT NULL DEFAULT 0, PRIMARY KEY (itemID, creatorID, creatorTypeID, orderIndex), UNIQUE (itemID, orderIndex))"),
+    QStringLiteral("CREATE TABLE collections (collectionID INTEGER PRIMARY KEY, collectionName TEXT NOT NULL, parentCollectionID INT DEFAULT NULL, clientDateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, libraryID INT NOT NULL, key TEXT NOT NULL, version INT NOT NULL DEFAULT 0, synced INT NOT NULL DEFAULT 0, UNIQUE (libraryID, key))"),
+    QStringLiteral("CREATE TABLE collectionItems (collectionID INT NOT NULL, itemID INT NOT NULL, orderIndex INT NOT NULL DEFAULT 0, PRIMARY KEY (collectionID, itemID))"),
+    QStringLiteral("CREATE INDEX collectionItems_itemID ON collectionItems(itemID)"),
+    QStringLiteral("CREATE TABLE deletedItems (itemID INTEGER PRIMARY KEY, dateDeleted DEFAULT CURRENT_TIMESTAMP NOT NULL)"),
+};
+const auto insertItem = QStringLiteral(
+    "INSERT INTO items (itemID, itemTypeID, dateAdded, dateModified, clientDateModified, libraryID, key, version) VALUES (?, ?, ?, ?, ?, 1, ?, ?)");
+const auto insertValue = QStringLiteral("INSERT INTO itemDataValues (valueID, value) VALUES (?, ?)");
+const auto insertData = QStringLiteral("INSERT INTO itemData (itemID, fieldID, valueID) VALUES (?, ?, ?)");
+const auto insertCreator = QStringLiteral("INSERT INTO itemCreators (itemID, creatorID, creatorTypeID, orderIndex) VALUES (?, ?, 1, ?)");
+const auto insertTag = QStringLiteral("INSERT OR IGNORE INTO itemTags (itemID, tagID, type) VALUES (?, ?, 0)");
+const auto insertCollectionItem = QStringLiteral("INSERT OR IGNORE INTO collectionItems (collectionID, itemID) VALUES (?, ?)");
+const auto insertAttachment = QStringLiteral("INSERT INTO itemAttachments (itemID, parentItemID, linkMode, contentType, path) VALUES (?, ?, ?, ?, ?)");
+const auto insertNote = QStringLiteral("INSERT INTO itemNotes (itemID, parentItemID, note, title) VALUES (?, ?, ?, ?)");
+const auto insertDeleted = QStringLiteral("INSERT INTO deletedItems (itemID, dateDeleted) VALUES (?, ?)");
+const auto selectRegularItems = QStringLiteral(R"(
+        SELECT items.itemID
+        FROM items
+                 JOIN itemTypes ON items.itemTypeID = itemTypes.itemTypeID
+        WHERE itemTypes.typeName NOT IN ('attachment', 'annotation', 'note')
+        ORDER BY items.itemID
+        )");
+const auto touchItem = QStringLiteral(
+    "UPDATE items SET dateModified = ?, clientDateModified = ?, version = (SELECT max(version) + 1 FROM items) WHERE itemID = ?");
+const auto touchLibrary = QStringLiteral("UPDATE libraries SET version = (SELECT max(version) FROM items)");
+} // namespace GeneratorSQL
+
+
+namespace
+{
+enum ItemType
+{
+    JournalArticle = 1,
+    Book,
+    ConferencePaper,
+    Preprint,
+    Thesis,
+    Attachment,
+    Note,
+    Annotation,
+};
+
+enum Field
+{
+    Title = 1,
+    AbstractNote,
+    Date,
+    DOI,
+    PublicationTitle,
+    JournalAbbreviation,
+    ConferenceName,
+    ProceedingsTitle,
+    Publisher,
+    ShortTitle,
+    Url,
+};
+
+const QStringList FIRST_NAMES = {
+    QStringLiteral("Alice"), QStringLiteral("Ben"), QStringLiteral("Chen"), QStringLiteral("Daniela"), QStringLiteral("Emil"),
+    QStringLiteral("Fatima"), QStringLiteral("Georg"), QStringLiteral("Hana"), QStringLiteral("Ivan"), QStringLiteral("Julia"),
+    QStringLiteral("Kenji"), QStringLiteral("Lena"), QStringLiteral("Mateo"), QStringLiteral("Nadia"), QStringLiteral("Oskar"),
+    QStringLiteral("Priya"), QStringLiteral("Quentin"), QStringLiteral("Rosa"), QStringLiteral("Sven"), QStringLiteral("Tomás"),
+    QStringLiteral("Ulrike"), QStringLiteral("Viet Anh"), QStringLiteral("Wei"), QStringLiteral("Ximena"), QStringLiteral("Yusuf"),
+    QStringLiteral("Zoë"), QStringLiteral("A."), QStringLiteral("J."), QStringLiteral("M."), QStringLiteral("S."),
+};
+
+const QStringList LAST_NAMES = {
+    QStringLiteral("Müller"), QStringLiteral("Smith"), QStringLiteral("Wang"), QStringLiteral("Nguyen"), QStringLiteral("García"),
+    QStringLiteral("Kowalski"), QStringLiteral("Tanaka"), QStringLiteral("Ivanova"), QStringLiteral("Okafor"), QStringLiteral("Schmidt"),
+    QStringLiteral("Johnson"), QStringLiteral("Li"), QStringLiteral("Tran"), QStringLiteral("Rossi"), QStringLiteral("Dubois"),
+    QStringLiteral("Novak"), QStringLiteral("Kim"), QStringLiteral("Andersson"), QStringLiteral("Silva"), QStringLiteral("Cohen"),
+    QStringLiteral("Hoffmann"), QStringLiteral("Brown"), QStringLiteral("Zhang"), QStringLiteral("Pham"), QStringLiteral("Fernández"),
+    QStringLiteral("Nowak"), QStringLiteral("Suzuki"), QStringLiteral("Petrov"), QStringLiteral("Adeyemi"), QStringLiteral("Weber"),
+    QStringLiteral("Williams"), QStringLiteral("Liu"), QStringLiteral("Le"), QStringLiteral("Bianchi"), QStringLiteral("Martin"),
+    QStringLiteral("Horvat"), QStringLiteral("Park"), QStringLiteral("Johansson"), QStringLiteral("Santos"), QStringLiteral("Levi"),
+    QStringLiteral("Wagner"), QStringLiteral("Jones"), QStringLiteral("Chen"), QStringLiteral("Hoang"), QStringLiteral("López"),
+    QStringLiteral("Wiśniewski"), QStringLiteral("Watanabe"), QStringLiteral("Smirnov"), QStringLiteral("Eze"), QStringLiteral("Becker"),
+    QStringLiteral("Mirzadeh"), QStringLiteral("Kirkpatrick"), QStringLiteral("Vaswani"), QStringLiteral("Hochreiter"), QStringLiteral("Bengio"),
+    QStringLiteral("Hinton"), QStringLiteral("LeCun"), QStringLiteral("Schmidhuber"), QStringLiteral("Goodfellow"), QStringLiteral("Sutskever"),
+};
+
+// loosely ordered by how common the words are in the titles of a machine learning library
+const QStringList VOCABULARY = {
+    QStringLiteral("learning"), QStringLiteral("neural"), QStringLiteral("networks"), QStringLiteral("deep"), QStringLiteral("models"),
+    QStringLiteral("data"), QStringLiteral("analysis"), QStringLiteral("towards"), QStringLiteral("efficient"), QStringLiteral("training"),
+    QStringLiteral("language"), QStringLiteral("representation"), QStringLiteral("continual"), QStringLiteral("attention"), QStringLiteral("transformer"),
+    QStringLiteral("optimization"), QStringLiteral("reinforcement"), QStringLiteral("generative"), QStringLiteral("adversarial"), QStringLiteral("robust"),
+    QStringLiteral("graph"), QStringLiteral("inference"), QStringLiteral("bayesian"), QStringLiteral("stochastic"), QStringLiteral("gradient"),
+    QStringLiteral("descent"), QStringLiteral("convolutional"), QStringLiteral("recurrent"), QStringLiteral("memory"), QStringLiteral("catastrophic"),
+    QStringLiteral("forgetting"), QStringLiteral("architecture"), QStringLiteral("matters"), QStringLiteral("scaling"), QStringLiteral("laws"),
+    QStringLiteral("self-supervised"), QStringLiteral("contrastive"), QStringLiteral("vision"), QStringLiteral("image"), QStringLiteral("segmentation"),
+    QStringLiteral("classification"), QStringLiteral("detection"), QStringLiteral("speech"), QStringLiteral("recognition"), QStringLiteral("translation"),
+    QStringLiteral("theory"), QStringLiteral("empirical"), QStringLiteral("study"), QStringLiteral("survey"), QStringLiteral("benchmark"),
+    QStringLiteral("dynamics"), QStringLiteral("plasticity"), QStringLiteral("synaptic"), QStringLiteral("cortex"), QStringLiteral("hippocampus"),
+    QStringLiteral("replay"), QStringLiteral("consolidation"), QStringLiteral("regularization"), QStringLiteral("dropout"), QStringLiteral("normalization"),
+    QStringLiteral("batch"), QStringLiteral("layer"), QStringLiteral("residual"), QStringLiteral("embedding"), QStringLiteral("sparse"),
+    QStringLiteral("mixture"), QStringLiteral("experts"), QStringLiteral("distillation"), QStringLiteral("pruning"), QStringLiteral("quantization"),
+    QStringLiteral("federated"), QStringLiteral("privacy"), QStringLiteral("fairness"), QStringLiteral("causal"), QStringLiteral("discovery"),
+    QStringLiteral("kernel"), QStringLiteral("gaussian"), QStringLiteral("process"), QStringLiteral("variational"), QStringLiteral("autoencoder"),
+    QStringLiteral("diffusion"), QStringLiteral("probabilistic"), QStringLiteral("uncertainty"), QStringLiteral("calibration"), QStringLiteral("generalization"),
+    QStringLiteral("overparameterized"), QStringLiteral("lottery"), QStringLiteral("ticket"), QStringLiteral("hypothesis"), QStringLiteral("meta-learning"),
+    QStringLiteral("few-shot"), QStringLiteral("zero-shot"), QStringLiteral("transfer"), QStringLiteral("domain"), QStringLiteral("adaptation"),
+    QStringLiteral("curriculum"), QStringLiteral("exploration"), QStringLiteral("policy"), QStringLiteral("value"), QStringLiteral("function"),
+    QStringLiteral("approximation"), QStringLiteral("planning"), QStringLiteral("world"), QStringLiteral("agents"), QStringLiteral("multi-agent"),
+    QStringLiteral("communication"), QStringLiteral("emergent"), QStringLiteral("compositional"), QStringLiteral("symbolic"), QStringLiteral("reasoning"),
+    QStringLiteral("retrieval"), QStringLiteral("augmented"), QStringLiteral("generation"), QStringLiteral("question"), QStringLiteral("answering"),
+    QStringLiteral("summarization"), QStringLiteral("dialogue"), QStringLiteral("sentiment"), QStringLiteral("tokenization"), QStringLiteral("multilingual"),
+    QStringLiteral("protein"), QStringLiteral("folding"), QStringLiteral("molecular"), QStringLiteral("chemistry"), QStringLiteral("climate"),
+    QStringLiteral("weather"), QStringLiteral("forecasting"), QStringLiteral("time"), QStringLiteral("series"), QStringLiteral("anomaly"),
+    QStringLiteral("clustering"), QStringLiteral("dimensionality"), QStringLiteral("reduction"), QStringLiteral("manifold"), QStringLiteral("topology"),
+    QStringLiteral("geometry"), QStringLiteral("equivariant"), QStringLiteral("symmetry"), QStringLiteral("invariance"), QStringLiteral("physics"),
+    QStringLiteral("informed"), QStringLiteral("differential"), QStringLiteral("equations"), QStringLiteral("spiking"), QStringLiteral("neuromorphic"),
+    QStringLiteral("hardware"), QStringLiteral("accelerator"), QStringLiteral("compiler"), QStringLiteral("distributed"), QStringLiteral("parallel"),
+    QStringLiteral("asynchronous"), QStringLiteral("consensus"), QStringLiteral("interpretability"), QStringLiteral("explanations"), QStringLiteral("saliency"),
+    QStringLiteral("mechanistic"), QStringLiteral("circuits"), QStringLiteral("alignment"), QStringLiteral("preference"), QStringLiteral("feedback"),
+    QStringLiteral("human"), QStringLiteral("evaluation"), QStringLiteral("metrics"), QStringLiteral("reproducibility"), QStringLiteral("open"),
+    QStringLiteral("problems"), QStringLiteral("revisited"), QStringLiteral("rethinking"), QStringLiteral("beyond"), QStringLiteral("understanding"),
+    QStringLiteral("implicit"), QStringLiteral("bias"), QStringLiteral("loss"), QStringLiteral("landscape"), QStringLiteral("sharpness"),
+    QStringLiteral("minima"), QStringLiteral("mode"), QStringLiteral("connectivity"), QStringLiteral("linear"), QStringLiteral("interpolation"),
+    QStringLiteral("permutation"), QStringLiteral("merging"), QStringLiteral("ensembles"), QStringLiteral("hebbian"), QStringLiteral("predictive"),
+    QStringLiteral("coding"), QStringLiteral("active"), QStringLiteral("dendritic"), QStringLiteral("neuromodulation"), QStringLiteral("oscillations"),
+};
+
+const QString KEY_ALPHABET = QStringLiteral("23456789ABCDEFGHIJKLMNPQRSTUVWXYZ");
+
+// Zotero keys are 8 characters from KEY_ALPHABET, here derived from the id so they are unique
+QString zoteroKey(quint64 id)
+{
+    QString key(8, KEY_ALPHABET.front());
+    for (qsizetype i = key.size() - 1; i >= 0 && id > 0; --i)
+    {
+        key[i] = KEY_ALPHABET[static_cast<qsizetype>(id % KEY_ALPHABET.size())];
+        id /= KEY_ALPHABET.size();
+    }
+    return key;
+}
+
+/// Random text drawn from VOCABULARY
+class TextGenerator
+{
+public:
+    explicit TextGenerator(const std::uint32_t seed) : m_random(seed) {}
+
+    /**
+     * A note as the Zotero 7 editor stores it: paragraphs with inline markup, character references,
+     * lists, links and citations, whose data-citation attribute holds URL-encoded JSON. A few notes
+     * embed an image as a base64 data URI, as older notes and notes pasted from the web do.
+     */
+    QString note(const QString& heading)
+    {
+        QString note = QStringLiteral("<div data-schema-version=\"9\"><h1>%1</h1>\n").arg(heading);
+        for (int p = 1 + poisson(2.0); p > 0; --p)
+        {
+            note += QStringLiteral("<p>%1 <strong>%2</strong> %3").arg(words(10 + poisson(20.0), true), words(2, false), words(5 + poisson(10.0), false));
+            if (uniform() < 0.3)
+                note += QStringLiteral(" &amp; %1&nbsp;&ndash; %2").arg(words(2, false), words(3, false));
+            if (uniform() < 0.3)
+            {
+                // the encoded JSON is full of '%', so it is concatenated rather than passed through arg()
+                const QString key = zoteroKey(std::uniform_int_distribution<quint64>(1, 1000000)(m_random));
+                note += QStringLiteral(" <span class=\"citation\" data-citation=\"%7B%22citationItems%22%3A%5B%7B%22uris%22%3A%5B%22"
+                                       "http%3A%2F%2Fzotero.org%2Fusers%2Flocal%2FAbCdEfGh%2Fitems%2F")
+                    + key + QStringLiteral("%22%5D%7D%5D%2C%22properties%22%3A%7B%7D%7D\">")
+                    + QStringLiteral("(<span class=\"citation-item\">%1, %2</span>)</span>")
+                          .arg(LAST_NAMES[skewed(static_cast<int>(LAST_NAMES.size()))])
+                          .arg(1990 + static_cast<int>(uniform() * 35));
+            }
+            if (uniform() < 0.2)
+                note += QStringLiteral(" <a href=\"https://doi.org/10.%1/%2\" rel=\"noopener noreferrer nofollow\">%3</a>")
+                            .arg(1000 + static_cast<int>(uniform() * 9000))
+                            .arg(static_cast<int>(uniform() * 100000))
+                            .arg(words(3, false));
+            note += QStringLiteral(".</p>\n");
+        }
+        if (uniform() < 0.2)
+        {
+            note += QStringLiteral("<ul>");
+            for (int i = 1 + poisson(2.0); i > 0; --i)
+                note += QStringLiteral("<li>%1</li>").arg(words(3 + poisson(5.0), true));
+            note += QStringLiteral("</ul>\n");
+        }
+        if (uniform() < 0.05)
+        {
+            note += QStringLiteral("<p><img alt=\"\" src=\"data:image/png;base64,%1\"></p>\n").arg(base64(2048 + poisson(8192.0)));
+        }
+        note += QStringLiteral("</div>");
+        return note;
+    }
+
+protected:
+    std::mt19937 m_random;
+
+    double uniform() { return std::uniform_real_distribution<>(0.0, 1.0)(m_random); }
+    int poisson(const double mean) { return mean > 0.0 ? std::poisson_distribution<>(mean)(m_random) : 0; }
+    // index into a pool of @p size, strongly preferring the front
+    int skewed(const int size) { return std::min(size - 1, static_cast<int>(std::pow(uniform(), 3.0) * size)); }
+
+    QString words(const int count, const bool capitalize)
+    {
+        QStringList result;
+        for (int i = 0; i < count; ++i)
+        {
+            result.append(VOCABULARY[skewed(static_cast<int>(VOCABULARY.size()))]);
+        }
+        QString text = result.join(QLatin1Char(' '));
+        if (capitalize && !text.isEmpty())
+            text[0] = text[0].toUpper();
+        return text;
+    }
+
+    // @p length random characters of the base64 alphabet
+    QString base64(const int length)
+    {
+        static const QString alphabet = QStringLiteral("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+        QString text(length, QLatin1Char('A'));
+        for (qsizetype i = 0; i < text.size(); ++i)
+            text[i] = alphabet[std::uniform_int_distribution<qsizetype>(0, alphabet.size() - 1)(m_random)];
+        return text;
+    }
+};
+
+class Generator : public TextGenerator
+{
+public:
+    Generator(QSqlDatabase& db, const LibraryOptions& options) : TextGenerator(options.seed), m_db(db), m_options(options) {}
+
+    bool run()
+    {
+        for (const QString& statement : GeneratorSQL::createTables)
+        {
+            if (!exec(statement))
+                return false;
+        }
+        if (!insertFixedRows())
+            return false;
+
+        m_item = QSqlQuery(m_db);
+        m_value = QSqlQuery(m_db);
+        m_data = QSqlQuery(m_db);
+        m_creator = QSqlQuery(m_db);
+        m_tag = QSqlQuery(m_db);
+        m_collection = QSqlQuery(m_db);
+        m_attachment = QSqlQuery(m_db);
+        m_note = QSqlQuery(m_db);
+        m_deleted = QSqlQuery(m_db);
+        if (!m_item.prepare(GeneratorSQL::insertItem) || !m_value.prepare(GeneratorSQL::insertValue)
+            || !m_data.prepare(GeneratorSQL::insertData) || !m_creator.prepare(GeneratorSQL::insertCreator)
+            || !m_tag.prepare(GeneratorSQL::insertTag) || !m_collection.prepare(GeneratorSQL::insertCollectionItem)
+            || !m_attachment.prepare(GeneratorSQL::insertAttachment) || !m_note.prepare(GeneratorSQL::insertNote)
+            || !m_deleted.prepare(GeneratorSQL::insertDeleted))
+        {
+            qCritical() << "Failed to prepare generator statements:" << m_db.lastError().text();
+            return false;
+        }
+
+        for (int i = 0; i < m_options.items; ++i)
+        {
+            if (!addRegularItem())
+                return false;
+        }
+        return exec(QStringLiteral("UPDATE libraries SET version = %1").arg(m_version));
+    }
+
+private:
+    QSqlDatabase& m_db;
+    const LibraryOptions& m_options;
+    QSqlQuery m_item, m_value, m_data, m_creator, m_tag, m_collection, m_attachment, m_note, m_deleted;
+    QHash<QString, int> m_values;
+    int m_itemId = 0;
+    int m_version = 0;
+    int m_creators = 0;
+    int m_tags = 0;
+    int m_collections = 0;
+    QDateTime m_modified = QDateTime(QDate(2015, 1, 1), QTime(9, 0), QTimeZone::UTC);
+
+    bool exec(const QString& statement)
+    {
+        if (QSqlQuery query(m_db); !query.exec(statement))
+        {
+            qCritical() << "Failed to execute" << statement << ":" << query.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    static bool exec(QSqlQuery& query)
+    {
+        if (!query.exec())
+        {
+            qCritical() << "Failed to execute" << query.lastQuery() << ":" << query.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    bool insertFixedRows()
+    {
+        bool ok = exec(QStringLiteral("INSERT INTO libraries (libraryID, type, editable, filesEditable) VALUES (1, 'user', 1, 1)"));
+        const std::array types = {
+            QStringLiteral("journalArticle"), QStringLiteral("book"), QStringLiteral("conferencePaper"), QStringLiteral("preprint"),
+            QStringLiteral("thesis"), QStringLiteral("attachment"), QStringLiteral("note"), QStringLiteral("annotation"),
+        };
+        for (std::size_t i = 0; i < types.size(); ++i)
+            ok = ok && exec(QStringLiteral("INSERT INTO itemTypes (itemTypeID, typeName) VALUES (%1, '%2')").arg(i + 1).arg(types[i]));
+        const std::array fields = {
+            QStringLiteral("title"), QStringLiteral("abstractNote"), QStringLiteral("date"), QStringLiteral("DOI"),
+            QStringLiteral("publicationTitle"), QStringLiteral("journalAbbreviation"), QStringLiteral("conferenceName"),
+            QStringLiteral("proceedingsTitle"), QStringLiteral("publisher"), QStringLiteral("shortTitle"), QStringLiteral("url"),
+        };
+        for (std::size_t i = 0; i < fields.size(); ++i)
+            ok = ok && exec(QStringLiteral("INSERT INTO fields (fieldID, fieldName) VALUES (%1, '%2')").arg(i + 1).arg(fields[i]));
+        ok = ok && exec(QStringLiteral("INSERT INTO creatorTypes (creatorTypeID, creatorType) VALUES (1, 'author')"));
+
+        QSqlQuery creator(m_db);
+        QSqlQuery tag(m_db);
+        QSqlQuery collection(m_db);
+        if (!ok || !creator.prepare(QStringLiteral("INSERT INTO creators (creatorID, firstName, lastName, fieldMode) VALUES (?, ?, ?, 0)"))
+            || !tag.prepare(QStringLiteral("INSERT INTO tags (tagID, name) VALUES (?, ?)"))
+            || !collection.prepare(QStringLiteral("INSERT INTO collections (collectionID, collectionName, clientDateModified, libraryID, key, version) VALUES (?, ?, ?, 1, ?, 0)")))
+        {
+            return false;
+        }
+        // every creator is a distinct combination of first and last name
+        m_creators = std::min(m_options.creatorPool, static_cast<int>(FIRST_NAMES.size() * LAST_NAMES.size()));
+        for (int i = 0; i < m_creators && ok; ++i)
+        {
+            creator.addBindValue(i + 1);
+            creator.addBindValue(FIRST_NAMES[i % FIRST_NAMES.size()]);
+            creator.addBindValue(LAST_NAMES[i / FIRST_NAMES.size()]);
+            ok = exec(creator);
+        }
+        m_tags = m_options.tagPool;
+        for (int i = 0; i < m_tags && ok; ++i)
+        {
+            tag.addBindValue(i + 1);
+            const QString& word = VOCABULARY[i % VOCABULARY.size()];
+            tag.addBindValue(i < static_cast<int>(VOCABULARY.size()) ? word : QStringLiteral("%1 %2").arg(word).arg(i / VOCABULARY.size()));
+            ok = exec(tag);
+        }
+        m_collections = m_options.collectionPool;
+        for (int i = 0; i < m_collections && ok; ++i)
+        {
+            collection.addBindValue(i + 1);
+            collection.addBindValue(words(2, true));
+            collection.addBindValue(m_modified.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss")));
+            // far above all item ids, so collection keys never collide with item keys
+            collection.addBindValue(zoteroKey(quint64{1} << 36 | static_cast<quint64>(i)));
+            ok = exec(collection);
+        }
+        return ok;
+    }
+
+    bool addItem(const int type)
+    {
+        ++m_itemId;
+        ++m_version;
+        // a few minutes between items, so dates are ordered like the ids
+        m_modified = m_modified.addSecs(60 + static_cast<qint64>(uniform() * 600));
+        const QString modified = m_modified.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+        m_item.addBindValue(m_itemId);
+        m_item.addBindValue(type);
+        m_item.addBindValue(modified);
+        m_item.addBindValue(modified);
+        m_item.addBindValue(modified);
+        m_item.addBindValue(zoteroKey(static_cast<quint64>(m_itemId)));
+        m_item.addBindValue(m_version);
+        return exec(m_item);
+    }
+
+    bool addData(const int itemId, const int field, const QString& value)
+    {
+        auto valueId = m_values.constFind(value);
+        if (valueId == m_values.cend())
+        {
+            valueId = m_values.insert(value, static_cast<int>(m_values.size()) + 1);
+            m_value.addBindValue(valueId.value());
+            m_value.addBindValue(value);
+            if (!exec(m_value))
+                return false;
+        }
+        m_data.addBindValue(itemId);
+        m_data.addBindValue(field);
+        m_data.addBindValue(valueId.value());
+        return exec(m_data);
+    }
+
+    bool addRegularItem()
+    {
+        const int type = JournalArticle + std::min(4, static_cast<int>(uniform() * uniform() * 5));
+        if (!addItem(type))
+            return false;
+        const int id = m_itemId;
+        const int year = 1990 + static_cast<int>(std::sqrt(uniform()) * 35);
+        const QString title = words(4 + poisson(5.0), true);
+
+        bool ok = addData(id, Title, title)
+            && addData(id, Date, QStringLiteral("%1-%2-00 %1-%2").arg(year).arg(1 + static_cast<int>(uniform() * 12), 2, 10, QLatin1Char('0')));
+        if (ok && uniform() < 0.8)
+            ok = addData(id, AbstractNote, words(40 + poisson(80.0), true) + QLatin1Char('.'));
+        if (ok && uniform() < 0.7)
+            ok = addData(id, DOI, QStringLiteral("10.%1/%2.%3").arg(1000 + static_cast<int>(uniform() * 9000)).arg(year).arg(id));
+        if (ok && uniform() < 0.2)
+            ok = addData(id, ShortTitle, title.section(QLatin1Char(' '), 0, 2));
+        if (ok && uniform() < 0.5)
+            ok = addData(id, Url, QStringLiteral("https://example.org/papers/%1").arg(zoteroKey(static_cast<quint64>(id))));
+        switch (type)
+        {
+        case JournalArticle:
+            {
+                const QString journal = QStringLiteral("Journal of ") + words(2, true);
+                ok = ok && addData(id, PublicationTitle, journal) && addData(id, JournalAbbreviation, journal.left(12));
+                break;
+            }
+        case ConferencePaper:
+            {
+                const QString conference = QStringLiteral("Conference on ") + words(2, true);
+                ok = ok && addData(id, ConferenceName, conference) && addData(id, ProceedingsTitle, QStringLiteral("Proceedings of the ") + conference);
+                break;
+            }
+        case Book:
+        case Thesis:
+            ok = ok && addData(id, Publisher, words(1, true) + QStringLiteral(" Press"));
+            break;
+        default:
+            break;
+        }
+
+        const int authors = 1 + std::min(19, poisson(2.0));
+        for (int i = 0; i < authors && ok; ++i)
+        {
+            m_creator.addBindValue(id);
+            m_creator.addBindValue(1 + skewed(m_creators));
+            m_creator.addBindValue(i);
+            ok = exec(m_creator);
+        }
+        for (int i = poisson(m_options.tags); i > 0 && ok; --i)
+        {
+            m_tag.addBindValue(id);
+            m_tag.addBindValue(1 + skewed(m_tags));
+            ok = exec(m_tag);
+        }
+        for (int i = poisson(m_options.collections); i > 0 && ok && m_collections > 0; --i)
+        {
+            m_collection.addBindValue(1 + skewed(m_collections));
+            m_collection.addBindValue(id);
+            ok = exec(m_collection);
+        }
+        if (ok && uniform() < m_options.trashed)
+        {
+            m_deleted.addBindValue(id);
+            m_deleted.addBindValue(m_modified.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss")));
+            ok = exec(m_deleted);
+        }
+
+        for (int i = poisson(m_options.attachments); i > 0 && ok; --i)
+        {
+            const bool pdf = uniform() < 0.8;
+            ok = addItem(Attachment) && addData(m_itemId, Title, pdf ? QStringLiteral("Full Text PDF") : QStringLiteral("Snapshot"));
+            m_attachment.addBindValue(m_itemId);
+            m_attachment.addBindValue(id);
+            m_attachment.addBindValue(pdf ? 0 : 1);
+            m_attachment.addBindValue(pdf ? QStringLiteral("application/pdf") : QStringLiteral("text/html"));
+            m_attachment.addBindValue(QStringLiteral("storage:%1 - %2.%3").arg(year).arg(title.left(40), pdf ? QStringLiteral("pdf") : QStringLiteral("html")));
+            ok = ok && exec(m_attachment);
+        }
+        for (int i = poisson(m_options.notes); i > 0 && ok; --i)
+        {
+            const QString heading = words(3, true);
+            ok = addItem(Note);
+            m_note.addBindValue(m_itemId);
+            m_note.addBindValue(id);
+            m_note.addBindValue(note(heading));
+            m_note.addBindValue(heading);
+            ok = ok && exec(m_note);
+        }
+        return ok;
+    }
+};
+
+// runs @p work in one transaction on a connection of its own to @p path
+template <typename Work>
+bool withDatabase(const QString& path, Work&& work)
+{
+    const auto connectionId = QUuid::createUuid().toString();
+    bool ok = false;
+    {
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
+        db.setDatabaseName(path);
+        if (!db.open())
+        {
+            qCritical() << "Failed to open" << path << ":" << db.lastError().text();
+        }
+        else if (db.transaction())
+        {
+            ok = work(db) && db.commit();
+            if (!ok)
+            {
+                db.rollback();
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionId);
+    return ok;
+}
+} // namespace
+
+
+bool LibraryGenerator::generate(const QString& path, const LibraryOptions& options)
+{
+    return withDatabase(path, [&options](QSqlDatabase& db)
+    {
+        Generator generator(db, options);
+        return generator.run();
+    });
+}
+
+bool LibraryGenerator::touch(const QString& path, const int count, const std::uint32_t seed)
+{
+    return withDatabase(path, [count, seed](QSqlDatabase& db)
+    {
+        QSqlQuery query(db);
+        std::vector<int> ids;
+        if (!query.exec(GeneratorSQL::selectRegularItems))
+            return false;
+        while (query.next())
+            ids.push_back(query.value(0).toInt());
+
+        std::mt19937 random(seed);
+        std::shuffle(ids.begin(), ids.end(), random);
+        ids.resize(std::min(ids.size(), static_cast<std::size_t>(std::max(count, 0))));
+
+        // later than every generated date
+        const QString now = QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+        QSqlQuery touchQuery(db);
+        if (!touchQuery.prepare(GeneratorSQL::touchItem))
+            return false;
+        for (const int id : ids)
+        {
+            touchQuery.addBindValue(now);
+            touchQuery.addBindValue(now);
+            touchQuery.addBindValue(id);
+            if (!touchQuery.exec())
+                return false;
+        }
+        return query.exec(GeneratorSQL::touchLibrary);
+    });
+}
+
+std::vector<std::string> LibraryGenerator::notes(const qint64 bytes, const std::uint32_t seed)
+{
+    TextGenerator generator(seed);
+    std::vector<std::string> notes;
+    qint64 total = 0;
+    while (total < bytes)
+    {
+        notes.push_back(generator.note(QStringLiteral("Note %1").arg(notes.size() + 1)).toStdString());
+        total += static_cast<qint64>(notes.back().size());
+    }
+    return notes;
+}
+
+const QStringList& LibraryGenerator::vocabulary()
+{
+    return VOCABULARY;
+}
+
+const QStringList& LibraryGenerator::lastNames()
+{
+    return LAST_NAMES;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/// Shape of a synthetic Zotero library, see LibraryGenerator::generate()
+struct LibraryOptions
+{
+    int items = 1000;
+    std::uint32_t seed = 42;
+    // averages per regular item
+    double notes = 0.5;
+    double attachments = 1.2;
+    double tags = 3.0;
+    double collections = 1.0;
+    // sizes of the pools tags, collections and authors are drawn from
+    int tagPool = 500;
+    int collectionPool = 60;
+    int creatorPool = 1500;
+    // share of items in the trash
+    double trashed = 0.01;
+};
+
+
+/**
+ * @brief Writes synthetic libraries with the subset of the Zotero 7 schema the runner reads.
+ *
+ * Titles, abstracts and notes are drawn from a fixed vocabulary with a skewed distribution, so a
+ * few words are very common and most are rare, like in a real library. The same options and seed
+ * always produce the same library.
+ */
+namespace LibraryGenerator
+{
+/// Creates a new library at @p path, which must not exist yet
+bool generate(const QString& path, const LibraryOptions& options);
+/// Edits @p count random items the way Zotero does, so the next index update is an incremental one
+bool touch(const QString& path, int count, std::uint32_t seed);
+/// HTML notes like those of generated libraries, adding up to at least @p bytes of UTF-8
+std::vector<std::string> notes(qint64 bytes, std::uint32_t seed);
+
+/// Words titles, abstracts and notes are made of, most common first
+const QStringList& vocabulary();
+/// Last names authors are drawn from
+const QStringList& lastNames();
+} // namespace LibraryGenerator
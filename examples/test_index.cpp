@@ -7,8 +7,12 @@
 int main(int argc, char **argv)
 {
     QApplication app(argc, argv);
-    const Zotero zotero(QStringLiteral("/home/work/zotero_toy.sql"));
-    auto index = Index(QStringLiteral("/home/work/index_toy.sql"), zotero);
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <zotero.sqlite> <index.sqlite>" << std::endl;
+        return 1;
+    }
+    const Zotero zotero(QString::fromLocal8Bit(argv[1]));
+    auto index = Index(QString::fromLocal8Bit(argv[2]), zotero);
     // ReSharper disable once CppExpressionWithoutSideEffects
     index.setup();
     index.update();
@@ -18,11 +22,12 @@ int main(int argc, char **argv)
     std::getline(std::cin, name);
     std::cout << "Searching for " << name << std::endl;
 
-    for (const auto &[item, score] : index.search(QString::fromStdString(name))) {
-        qWarning() << item.key << QStringLiteral(" score ") << score;
-        for (const auto &attachment : item.attachments) {
-            if (attachment.contentType == "application/pdf") {
-                std::cout << attachment.key << std::endl;
+    const auto results = index.search(QString::fromStdString(name));
+    for (const auto &[item, score] : results.hits) {
+        qWarning() << QString::fromUtf8(item.key()) << QStringLiteral(" score ") << score;
+        for (std::size_t i = 0; i < item.attachmentCount(); ++i) {
+            if (const auto attachment = item.attachment(i); attachment.contentType() == "application/pdf") {
+                std::cout << attachment.key() << std::endl;
             }
         }
     }
@@ -6,8 +6,12 @@ using json = nlohmann::json;
 int main(int argc, char **argv)
 {
     QApplication app(argc, argv);
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <zotero.sqlite>" << std::endl;
+        return 1;
+    }
 
-    Zotero zotero(QStringLiteral("/home/work/zotero_toy.sql"));
+    Zotero zotero(QString::fromLocal8Bit(argv[1]));
     for (const auto &&item : zotero.items()) {
         json j = item;
         std::cout << j << std::endl;
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+
+/**
+ * @brief Blocking multi-producer, multi-consumer queue with a fixed capacity.
+ *
+ * Producers block while the queue is full, so a fast stage cannot run away from a slow one and
+ * memory stays bounded. close() ends the stream: pending values are still popped, after that
+ * pop() returns std::nullopt, and any further push() fails. Consumers that give up early close
+ * the queue as well, which unblocks and stops their producers.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(const std::size_t capacity) : m_capacity(capacity) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /// @return false if the queue was closed, in which case @p value is dropped
+    bool push(T&& value)
+    {
+        std::unique_lock lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_closed || m_values.size() < m_capacity; });
+        if (m_closed)
+            return false;
+        m_values.push_back(std::move(value));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// @return std::nullopt once the queue is closed and drained
+    std::optional<T> pop()
+    {
+        std::unique_lock lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return m_closed || !m_values.empty(); });
+        if (m_values.empty())
+            return std::nullopt;
+        T value = std::move(m_values.front());
+        m_values.pop_front();
+        m_notFull.notify_one();
+        return value;
+    }
+
+    void close()
+    {
+        {
+            const std::lock_guard lock(m_mutex);
+            m_closed = true;
+        }
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    const std::size_t m_capacity;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<T> m_values;
+    bool m_closed = false;
+};
@@ -0,0 +1,235 @@
+#include "connection_pool.h"
+
+#include <QSqlError>
+#include <QThread>
+#include <QUuid>
+
+#include <mutex>
+#include <sqlite3.h>
+
+Q_LOGGING_CATEGORY(KRunnerZoteroConnectionPool, "krunner-zotero/connection-pool")
+
+namespace
+{
+// innermost CancellationScope of the current thread; connections are only used by their own thread
+thread_local const std::function<bool()>* t_isCancelled = nullptr;
+// set while ConnectionPool::open() opens a connection on this thread, and whether that got a progress handler
+thread_local bool t_opening = false;
+thread_local bool t_cancellable = false;
+
+void registerAutoExtension(int (*extension)(sqlite3*, char**, const sqlite3_api_routines*))
+{
+    static std::once_flag registered;
+    std::call_once(registered, [extension]() { sqlite3_auto_extension(reinterpret_cast<void (*)()>(extension)); });
+}
+}
+
+
+ConnectionPool::ConnectionPool(QString dbPath, QString connectOptions) : m_dbPath(std::move(dbPath)),
+                                                                         m_connectOptions(std::move(connectOptions)),
+                                                                         m_poolId(QUuid::createUuid().toString(QUuid::WithoutBraces))
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    // connections must be closed by the thread which opened them, so those of other threads stay open until
+    // their thread finishes, and the hook that releases them keeps them alive until then
+    release(*m_connections, QThread::currentThread());
+}
+
+ConnectionPool::Lease ConnectionPool::lease()
+{
+    return Lease(connection());
+}
+
+ConnectionPool::Lease::Lease(Connection* connection) : m_connection(connection)
+{
+    if (m_connection != nullptr)
+    {
+        ++m_connection->leases;
+    }
+}
+
+ConnectionPool::Lease::~Lease()
+{
+    if (m_connection != nullptr)
+    {
+        --m_connection->leases;
+    }
+}
+
+QSqlQuery* ConnectionPool::Lease::statement(const QString& sql) const
+{
+    if (m_connection == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (const auto it = m_connection->statements.find(sql); it != m_connection->statements.end())
+    {
+        return &it.value();
+    }
+
+    QSqlQuery query(QSqlDatabase::database(m_connection->name, false));
+    if (!query.prepare(sql))
+    {
+        qCCritical(KRunnerZoteroConnectionPool) << "Failed to prepare statement:" << query.lastError().text();
+        return nullptr;
+    }
+    return &m_connection->statements.insert(sql, std::move(query)).value();
+}
+
+void ConnectionPool::invalidate()
+{
+    qCDebug(KRunnerZoteroConnectionPool) << "Invalidating connections to" << m_dbPath;
+    m_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+ConnectionPool::Connection* ConnectionPool::connection()
+{
+    QThread* thread = QThread::currentThread();
+    Connection* conn;
+    {
+        const QMutexLocker locker(&m_connections->mutex);
+        auto& slot = m_connections->byThread[thread];
+        if (!slot)
+        {
+            slot = std::make_unique<Connection>();
+            slot->name = QStringLiteral("krunner-zotero-%1-%2").arg(m_poolId).arg(reinterpret_cast<quintptr>(thread), 0, 16);
+            // connections must be closed by the thread which opened them
+            m_connections->finishedHooks[thread] = QObject::connect(thread, &QThread::finished,
+                                                                    [connections = m_connections, thread]() { release(*connections, thread); });
+        }
+        conn = slot.get();
+    }
+
+    // only the owning thread touches its connection, so no lock is needed from here on; a pinned connection
+    // is re-opened by the first lease after the current ones ended
+    if (const auto generation = m_generation.load(std::memory_order_acquire); conn->generation != generation
+        && (conn->leases == 0 || conn->generation == 0))
+    {
+        close(*conn);
+        if (!open(*conn))
+        {
+            return nullptr;
+        }
+        conn->generation = generation;
+    }
+    return conn;
+}
+
+bool ConnectionPool::open(Connection& connection) const
+{
+    /*
+     * The progress handler is installed by an auto extension of the SQLite library linked here, which
+     * that library runs for every connection it opens. Calling into the driver's handle directly
+     * would crash if Qt's driver came with its own copy of SQLite; then the extension simply never
+     * runs and statements cannot be cancelled.
+     */
+    registerAutoExtension(&ConnectionPool::installProgressHandler);
+
+    auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection.name);
+    db.setDatabaseName(m_dbPath);
+    db.setConnectOptions(m_connectOptions);
+    t_opening = true;
+    t_cancellable = false;
+    const bool opened = db.open();
+    t_opening = false;
+    if (!opened)
+    {
+        qCCritical(KRunnerZoteroConnectionPool) << "Failed to open database" << m_dbPath << ":" << db.lastError().text();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connection.name);
+        return false;
+    }
+    if (!t_cancellable)
+    {
+        qCWarning(KRunnerZoteroConnectionPool) << "Qt's SQLite driver does not use the SQLite library linked by krunner-zotero,"
+                                               << "statements of" << connection.name << "cannot be cancelled";
+    }
+    qCDebug(KRunnerZoteroConnectionPool) << "Opened connection" << connection.name;
+    return true;
+}
+
+bool ConnectionPool::driverUsesLinkedSqlite()
+{
+    // the auto extension only runs if the driver opens its connections with the linked library
+    static const bool linked = []()
+    {
+        registerAutoExtension(&ConnectionPool::installProgressHandler);
+        const auto connectionName = QUuid::createUuid().toString();
+        bool opened = false;
+        {
+            auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+            db.setDatabaseName(QStringLiteral(":memory:"));
+            t_opening = true;
+            t_cancellable = false;
+            opened = db.open();
+            t_opening = false;
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        if (!opened)
+        {
+            qCWarning(KRunnerZoteroConnectionPool) << "Failed to open an in-memory database to probe Qt's SQLite driver";
+        }
+        return opened && t_cancellable;
+    }();
+    return linked;
+}
+
+int ConnectionPool::installProgressHandler(sqlite3* db, char**, const sqlite3_api_routines*)
+{
+    // connections opened elsewhere, e.g. by the index writer, are left alone
+    if (t_opening)
+    {
+        sqlite3_progress_handler(db, PROGRESS_INTERVAL, &ConnectionPool::progress, nullptr);
+        t_cancellable = true;
+    }
+    return SQLITE_OK;
+}
+
+int ConnectionPool::progress(void*)
+{
+    // a non-zero result makes SQLite abort the running statement
+    return t_isCancelled != nullptr && (*t_isCancelled)() ? 1 : 0;
+}
+
+ConnectionPool::CancellationScope::CancellationScope(std::function<bool()> isCancelled) : m_isCancelled(std::move(isCancelled)),
+                                                                                          m_outer(t_isCancelled)
+{
+    if (m_isCancelled)
+    {
+        t_isCancelled = &m_isCancelled;
+    }
+}
+
+ConnectionPool::CancellationScope::~CancellationScope()
+{
+    t_isCancelled = m_outer;
+}
+
+void ConnectionPool::close(Connection& connection)
+{
+    connection.statements.clear();
+    connection.generation = 0;
+    if (QSqlDatabase::contains(connection.name))
+    {
+        QSqlDatabase::removeDatabase(connection.name);
+    }
+}
+
+void ConnectionPool::release(Connections& connections, QThread* thread)
+{
+    const QMutexLocker locker(&connections.mutex);
+    if (const auto it = connections.byThread.find(thread); it != connections.byThread.end())
+    {
+        close(*it->second);
+        connections.byThread.erase(it);
+    }
+    if (const auto it = connections.finishedHooks.find(thread); it != connections.finishedHooks.end())
+    {
+        QObject::disconnect(it->second);
+        connections.finishedHooks.erase(it);
+    }
+}
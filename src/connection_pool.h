@@ -0,0 +1,146 @@
+#pragma once
+
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+class QThread;
+struct sqlite3;
+struct sqlite3_api_routines;
+
+Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroConnectionPool)
+
+
+/**
+ * @brief Long-lived, per-thread SQLite connections with cached prepared statements.
+ *
+ * QSqlDatabase connections may only be used from the thread that opened them, and KRunner calls
+ * match() from several threads. Each thread therefore gets its own connection, opened on first use
+ * and kept until the thread finishes, which may be after the pool was destroyed. Statements are
+ * prepared once per connection and reused.
+ *
+ * Statements are only handed out through a Lease, which pins the calling thread's connection.
+ * invalidate() marks all connections as stale; every thread re-opens its connection (and
+ * re-prepares its statements) the next time it takes a lease while it holds none, so statements
+ * stay valid as long as the lease they came from.
+ */
+class ConnectionPool
+{
+public:
+    explicit ConnectionPool(QString dbPath, QString connectOptions = QStringLiteral("QSQLITE_OPEN_READONLY"));
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    class Lease;
+    /// Pins the calling thread's connection, re-opening it first if it is stale and not pinned yet
+    [[nodiscard]] Lease lease();
+
+    /// Forces all threads to re-open their connection, e.g. after the database was rebuilt.
+    void invalidate();
+
+    /**
+     * @brief Whether Qt's SQLite driver uses the SQLite library krunner-zotero links.
+     *
+     * Only then may a file the driver has open also be opened through the linked library: two
+     * copies of SQLite in one process do not see each other's POSIX locks. Probed once.
+     */
+    [[nodiscard]] static bool driverUsesLinkedSqlite();
+
+    /**
+     * @brief Aborts the calling thread's statements once @p isCancelled returns true.
+     *
+     * SQLite polls the check while a statement of a pooled connection is running; an aborted
+     * statement fails with SQLITE_INTERRUPT. Scopes nest, the innermost one is polled. This needs
+     * Qt's SQLite driver to use the SQLite library krunner-zotero links, otherwise statements
+     * always run to completion.
+     */
+    class CancellationScope
+    {
+    public:
+        explicit CancellationScope(std::function<bool()> isCancelled);
+        ~CancellationScope();
+
+        CancellationScope(const CancellationScope&) = delete;
+        CancellationScope& operator=(const CancellationScope&) = delete;
+
+    private:
+        const std::function<bool()> m_isCancelled;
+        const std::function<bool()>* m_outer;
+    };
+
+private:
+    // number of SQLite VM instructions between two polls of the CancellationScope
+    static constexpr int PROGRESS_INTERVAL = 1000;
+
+    struct Connection
+    {
+        QString name;
+        quint64 generation = 0;
+        QHash<QString, QSqlQuery> statements;
+        // leases of the owning thread, the connection is not re-opened while there are any
+        int leases = 0;
+    };
+
+public:
+    /**
+     * @brief The calling thread's connection, kept open for as long as the lease lives.
+     *
+     * Leases may nest on one thread and must not be passed to another one.
+     */
+    class Lease
+    {
+    public:
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        /**
+         * @brief Returns the statement for @p sql, preparing it on first use.
+         *
+         * The returned query is owned by the pool and stays valid until the lease ends.
+         *
+         * @return nullptr if the database could not be opened or the statement could not be prepared
+         */
+        [[nodiscard]] QSqlQuery* statement(const QString& sql) const;
+
+    private:
+        friend class ConnectionPool;
+        explicit Lease(Connection* connection);
+
+        Connection* const m_connection;
+    };
+
+private:
+
+    const QString m_dbPath;
+    const QString m_connectOptions;
+    const QString m_poolId;
+
+    std::atomic<quint64> m_generation = 1;
+    /// The connections of all threads, shared with the hooks that release them once their thread finishes
+    struct Connections
+    {
+        QMutex mutex;
+        std::unordered_map<QThread*, std::unique_ptr<Connection>> byThread;
+        std::unordered_map<QThread*, QMetaObject::Connection> finishedHooks;
+    };
+    const std::shared_ptr<Connections> m_connections = std::make_shared<Connections>();
+
+    Connection* connection();
+    bool open(Connection& connection) const;
+    static void close(Connection& connection);
+    static void release(Connections& connections, QThread* thread);
+    /// Auto extension of the linked SQLite library, installs progress() on the connection open() is opening
+    static int installProgressHandler(sqlite3* db, char** error, const sqlite3_api_routines* api);
+    static int progress(void*);
+};
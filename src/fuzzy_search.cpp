@@ -0,0 +1,61 @@
+#include "fuzzy_search.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+
+QStringList FuzzySearch::trigrams(const QStringList& words)
+{
+    QStringList result;
+    for (const auto& word : words)
+    {
+        for (qsizetype i = 0; i + 3 <= word.size(); ++i)
+        {
+            if (QString trigram = word.mid(i, 3).toCaseFolded(); !result.contains(trigram))
+            {
+                result.append(std::move(trigram));
+            }
+        }
+    }
+    return result;
+}
+
+qsizetype FuzzySearch::substringDistance(const QStringView word, const QStringView text)
+{
+    // Sellers' algorithm: edit distance where the match may start and end anywhere in text,
+    // computed column by column over text with a single column of the DP matrix
+    std::vector<qsizetype> column(word.size() + 1);
+    std::iota(column.begin(), column.end(), 0);
+    qsizetype best = column.back();
+    for (const QChar c : text)
+    {
+        qsizetype diagonal = 0; // a match may start at any position of text
+        for (qsizetype i = 1; i <= word.size(); ++i)
+        {
+            const qsizetype substitution = diagonal + (word[i - 1] == c ? 0 : 1);
+            diagonal = column[i];
+            column[i] = std::min({substitution, column[i] + 1, column[i - 1] + 1});
+        }
+        best = std::min(best, column.back());
+        if (best == 0)
+            break;
+    }
+    return best;
+}
+
+double FuzzySearch::similarity(const QStringList& words, const QString& text)
+{
+    const QString folded = text.toCaseFolded();
+    qsizetype typos = 0;
+    qsizetype length = 0;
+    for (const auto& word : words)
+    {
+        const auto distance = substringDistance(word, folded);
+        if (distance > maxTypos(word.size()))
+            return 0.0;
+        typos += distance;
+        length += word.size();
+    }
+    return length == 0 ? 0.0 : 1.0 - static_cast<double>(typos) / static_cast<double>(length);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+
+/**
+ * Typo-tolerant matching used when the FTS5 query finds too few items.
+ *
+ * Candidates are generated from a trigram index, so they share at least some trigrams with the
+ * needle, and are then re-ranked by how many edits it takes to find every word of the needle in
+ * the candidate's text.
+ */
+namespace FuzzySearch
+{
+/// Distinct, case-folded trigrams of all words with at least three characters
+[[nodiscard]] QStringList trigrams(const QStringList& words);
+
+/// Smallest number of edits to turn @p word into any substring of @p text
+[[nodiscard]] qsizetype substringDistance(QStringView word, QStringView text);
+
+/// Number of typos tolerated in a word of the given length
+[[nodiscard]] constexpr qsizetype maxTypos(const qsizetype length) { return length / 4; }
+
+/**
+ * @brief Similarity of @p text to all of the (case-folded) @p words.
+ *
+ * @return 1 if all words occur in @p text, less the more typos there are, and 0 if any word has
+ *         more than maxTypos() typos
+ */
+[[nodiscard]] double similarity(const QStringList& words, const QString& text);
+} // namespace FuzzySearch
@@ -1,13 +1,27 @@
 #include "index.h"
 
-#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QFile>
 
+#include "fuzzy_search.h"
+#include "stats.h"
+#include "trace.h"
 #include "zotero.h"
 
 #include <QString>
+#include <QStringList>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QThread>
 #include <QUuid>
+#include <QVersionNumber>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sqlite3.h>
+#include <span>
+#include <thread>
+#include <unordered_set>
 
 
 Q_LOGGING_CATEGORY(KRunnerZoteroIndex, "krunner-zotero/index")
@@ -15,26 +29,51 @@ Q_LOGGING_CATEGORY(KRunnerZoteroIndex, "krunner-zotero/index")
 
 using json = nlohmann::json;
 
-constexpr int DB_VERSION = 1;
+constexpr int DB_VERSION = 7;
+// number of items written per transaction in Index::update
+constexpr int UPDATE_BATCH_SIZE = 1000;
+// rows handed from one stage of the update pipeline to the next at once, and the most decoder threads used
+constexpr std::size_t PIPELINE_CHUNK_SIZE = 64;
+constexpr int MAX_DECODERS = 8;
+// number of hits returned by Index::search
+constexpr int SEARCH_LIMIT = 10;
+// candidates re-ranked by the fuzzy fallback, and how many trigram postings may be read to find them
+constexpr int FUZZY_CANDIDATES = 50;
+constexpr qint64 FUZZY_POSTINGS_BUDGET = 4000;
+// incremental updates changing at least this many items merge the FTS segments they added, up to this many pages
+constexpr int MERGE_THRESHOLD = UPDATE_BATCH_SIZE;
+constexpr int MERGE_PAGES = 500;
+// how long swapping in a rebuilt index waits for a concurrent writer
+constexpr int SWAP_BUSY_TIMEOUT_MS = 10000;
+// contentless FTS5 tables that support DELETE and REPLACE, which the search table is
+const QVersionNumber MIN_SQLITE_VERSION(3, 43, 0);
 
 template <typename T>
-std::string join(const std::vector<T>& vec, const char sep = ' ')
+QString join(const std::span<const T> values, const char sep = ' ')
 {
-    std::ostringstream oss;
-    for (size_t i = 0; i < vec.size(); ++i)
+    std::string joined;
+    for (size_t i = 0; i < values.size(); ++i)
     {
-        oss << vec[i];
-        if (i != vec.size() - 1)
+        joined += values[i];
+        if (i != values.size() - 1)
         {
-            oss << sep;
+            joined += sep;
         }
     }
-    return oss.str();
+    return QString::fromStdString(joined);
 }
 
+/// Schema steps that bring an index from version - 1 to version without extracting items from Zotero again
+struct Migration
+{
+    int version;
+    std::vector<QString> statements;
+};
+
 
 namespace IndexSQL
 {
+// search is contentless: it only serves MATCH and bm25, results are read from the item store
 const std::array createTables = {QStringLiteral(R"(
         CREATE VIRTUAL TABLE search USING fts5(
             key,
@@ -47,13 +86,25 @@ const std::array createTables = {QStringLiteral(R"(
             collections,
             notes,
             abstract,
-            publisher
+            publisher,
+            prefix = '2 3 4',
+            content = '',
+            contentless_delete = 1
         );
         )"),
                                  QStringLiteral(R"(
-        CREATE TABLE data (
-            key TEXT PRIMARY KEY NOT NULL,
-            obj TEXT DEFAULT "{}"
+        CREATE VIRTUAL TABLE fuzzy USING fts5(
+            title,
+            authors,
+            doi,
+            tokenize = 'trigram'
+        );
+        )"),
+                                 QStringLiteral("CREATE VIRTUAL TABLE fuzzy_vocab USING fts5vocab(fuzzy, 'row');"),
+                                 QStringLiteral(R"(
+        CREATE TABLE items (
+            id INTEGER PRIMARY KEY,
+            key TEXT UNIQUE NOT NULL
         );
         )"),
                                  QStringLiteral(R"(
@@ -64,36 +115,180 @@ const std::array createTables = {QStringLiteral(R"(
         )"),
                                  QStringLiteral("INSERT INTO dbinfo VALUES('version', %1);").arg(DB_VERSION)};
 const auto getVersion = QStringLiteral("SELECT value AS version FROM dbinfo WHERE key = 'version'");
-const std::array reset = {QStringLiteral("DROP TABLE IF EXISTS `data`;"),
-                          QStringLiteral("DROP TABLE IF EXISTS `dbinfo`;"),
-                          QStringLiteral("DROP TABLE IF EXISTS `search`;"),
-                          QStringLiteral("VACUUM;"),
-                          QStringLiteral("PRAGMA INTEGRITY_CHECK;")};
+const auto sqliteVersion = QStringLiteral("SELECT sqlite_version();");
+const auto setVersion = QStringLiteral("UPDATE dbinfo SET value = ? WHERE key = 'version';");
+// applied in order, each in its own transaction; indexes older than the first one's predecessor are rebuilt
+const std::array migrations = {
+    // prefix indexes for matching every word as a prefix, FTS5 tables cannot be altered so the table is copied
+    Migration{.version = 4,
+              .statements = {QStringLiteral(R"(
+        CREATE VIRTUAL TABLE search_v4 USING fts5(
+            key,
+            title,
+            shortTitle,
+            doi,
+            year,
+            authors,
+            tags,
+            collections,
+            notes,
+            abstract,
+            publisher,
+            prefix = '2 3 4'
+        );
+        )"),
+                             QStringLiteral(
+                                 "INSERT INTO search_v4 "
+                                 "(rowid, key, title, shortTitle, doi, year, authors, tags, collections, notes, abstract, publisher) "
+                                 "SELECT rowid, key, title, shortTitle, doi, year, authors, tags, collections, notes, abstract, publisher "
+                                 "FROM search;"),
+                             QStringLiteral("DROP TABLE search;"),
+                             QStringLiteral("ALTER TABLE search_v4 RENAME TO search;")}},
+    // trigram table of the typo-tolerant fallback; legal titles (caseName etc.) are only filled in on the next change
+    Migration{.version = 5,
+              .statements = {QStringLiteral(R"(
+        CREATE VIRTUAL TABLE fuzzy USING fts5(
+            title,
+            authors,
+            doi,
+            tokenize = 'trigram'
+        );
+        )"),
+                             QStringLiteral("CREATE VIRTUAL TABLE fuzzy_vocab USING fts5vocab(fuzzy, 'row');"),
+                             QStringLiteral("INSERT INTO fuzzy (rowid, title, authors, doi) "
+                                            "SELECT rowid, coalesce(title, shortTitle, key), authors, doi FROM search;")}},
+    // contentless search table, which no longer stores a second copy of notes and abstracts
+    Migration{.version = 6,
+              .statements = {QStringLiteral(R"(
+        CREATE VIRTUAL TABLE search_v6 USING fts5(
+            key,
+            title,
+            shortTitle,
+            doi,
+            year,
+            authors,
+            tags,
+            collections,
+            notes,
+            abstract,
+            publisher,
+            prefix = '2 3 4',
+            content = '',
+            contentless_delete = 1
+        );
+        )"),
+                             QStringLiteral(
+                                 "INSERT INTO search_v6 "
+                                 "(rowid, key, title, shortTitle, doi, year, authors, tags, collections, notes, abstract, publisher) "
+                                 "SELECT rowid, key, title, shortTitle, doi, year, authors, tags, collections, notes, abstract, publisher "
+                                 "FROM search;"),
+                             QStringLiteral("DROP TABLE search;"),
+                             QStringLiteral("ALTER TABLE search_v6 RENAME TO search;"),
+                             QStringLiteral("INSERT INTO search (search) VALUES('optimize');")}},
+    // notes as plain text instead of HTML: without its change mark, a complete index re-reads every item on the next
+    // update, which replaces the notes in place; an interrupted build starts over instead of resuming with HTML notes.
+    // Indexes written before builds were checkpointed only have a mark once complete, so they are marked as such first.
+    Migration{.version = 7,
+              .statements = {QStringLiteral("INSERT OR IGNORE INTO dbinfo (key, value) SELECT 'complete', 1 "
+                                            "WHERE EXISTS (SELECT 1 FROM dbinfo WHERE key = 'zoteroClientDateModified');"),
+                             QStringLiteral("DELETE FROM dbinfo WHERE key IN ('zoteroClientDateModified', 'checkpoint');")}},
+};
+const auto getBuildState = QStringLiteral(
+    "SELECT "
+    "(SELECT value FROM dbinfo WHERE key = 'zoteroClientDateModified'), "
+    "(SELECT value FROM dbinfo WHERE key = 'zoteroVersion'), "
+    "(SELECT value FROM dbinfo WHERE key = 'zoteroLibraryVersion'), "
+    "(SELECT value FROM dbinfo WHERE key = 'zoteroItemCount'), "
+    "(SELECT value FROM dbinfo WHERE key = 'zoteroTrashedCount'), "
+    "(SELECT value FROM dbinfo WHERE key = 'version'), "
+    "(SELECT value FROM dbinfo WHERE key = 'complete'), "
+    "(SELECT value FROM dbinfo WHERE key = 'checkpoint');");
+const auto setInfo = QStringLiteral("INSERT OR REPLACE INTO dbinfo (key, value) VALUES(?, ?);");
+// a full build leaves every FTS index in a single segment, the smallest and fastest to query
+const std::array optimize = {QStringLiteral("INSERT INTO search (search) VALUES('optimize');"),
+                             QStringLiteral("INSERT INTO fuzzy (fuzzy) VALUES('optimize');")};
+const std::array merge = {QStringLiteral("INSERT INTO search (search, rank) VALUES('merge', %1);").arg(MERGE_PAGES),
+                          QStringLiteral("INSERT INTO fuzzy (fuzzy, rank) VALUES('merge', %1);").arg(MERGE_PAGES)};
+const auto vacuum = QStringLiteral("VACUUM;");
+const auto clearCheckpoint = QStringLiteral("DELETE FROM dbinfo WHERE key = 'checkpoint';");
+const std::array dropTables = {QStringLiteral("DROP TABLE IF EXISTS `fuzzy_vocab`;"),
+                               QStringLiteral("DROP TABLE IF EXISTS `fuzzy`;"),
+                               QStringLiteral("DROP TABLE IF EXISTS `search`;"),
+                               QStringLiteral("DROP TABLE IF EXISTS `items`;"),
+                               QStringLiteral("DROP TABLE IF EXISTS `dbinfo`;")};
 const auto insertOrReplaceSearch = QStringLiteral(
     "INSERT OR REPLACE "
     "INTO search (rowid, key, title, shortTitle, doi, year, authors, tags, collections, notes, abstract, publisher) "
     "VALUES(:rowid, :key, :title, :shortTitle, :doi, :year, :authors, :tags, :collections, :notes, :abstract, :publisher);");
-const auto insertOrReplaceData = QStringLiteral("INSERT OR REPLACE INTO data (key, obj) VALUES(:key, :obj);");
+const auto insertOrReplaceFuzzy = QStringLiteral(
+    "INSERT OR REPLACE INTO fuzzy (rowid, title, authors, doi) VALUES(:rowid, :title, :authors, :doi);");
+const auto insertOrReplaceItem = QStringLiteral("INSERT OR REPLACE INTO items (id, key) VALUES(:id, :key);");
+const auto savepointItem = QStringLiteral("SAVEPOINT item;");
+const auto releaseItem = QStringLiteral("RELEASE item;");
+const auto rollbackToItem = QStringLiteral("ROLLBACK TO item;");
+const std::array bulkLoadPragmas = {QStringLiteral("PRAGMA journal_mode = WAL;"),
+                                    QStringLiteral("PRAGMA synchronous = NORMAL;"),
+                                    QStringLiteral("PRAGMA temp_store = MEMORY;"),
+                                    QStringLiteral("PRAGMA cache_size = -65536;")};
+const std::array incrementalPragmas = {QStringLiteral("PRAGMA journal_mode = WAL;"),
+                                       QStringLiteral("PRAGMA synchronous = NORMAL;"),
+                                       QStringLiteral("PRAGMA temp_store = MEMORY;"),
+                                       QStringLiteral("PRAGMA cache_size = -16384;")};
+const auto enableWal = QStringLiteral("PRAGMA journal_mode = WAL;");
+const auto disableSync = QStringLiteral("PRAGMA synchronous = OFF;");
 const auto search = QStringLiteral(
-    "SELECT rowid, *, bm25(search, 0.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.7, 0.5, 0.4, 0.4, 0.4) "
-    "AS score FROM search WHERE search MATCH ? "
-    "ORDER BY score LIMIT 10");
-const auto selectData = QStringLiteral("SELECT obj FROM data WHERE key = ?");
-const auto deleteKeysNotInSearch = QStringLiteral("DELETE FROM search WHERE key NOT IN (%1);");
-const auto deleteKeysNotInData = QStringLiteral("DELETE FROM data WHERE key NOT IN (%1);");
+    "SELECT rowid, bm25(search, 0.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.7, 0.5, 0.4, 0.4, 0.4) AS score "
+    "FROM search WHERE search MATCH ? "
+    "ORDER BY score LIMIT %1").arg(SEARCH_LIMIT);
+// document frequencies of the needle's trigrams, to read the postings of the rarest ones only
+const auto fuzzyTrigramFrequencies = QStringLiteral(
+    "SELECT term, doc FROM fuzzy_vocab WHERE term IN (SELECT value FROM json_each(?));");
+const auto fuzzyCandidates = QStringLiteral(
+    "SELECT rowid, title, authors, doi FROM fuzzy WHERE fuzzy MATCH ? ORDER BY rank LIMIT %1").arg(FUZZY_CANDIDATES);
+const auto createValidIds = QStringLiteral("CREATE TEMP TABLE IF NOT EXISTS validIds (id INTEGER PRIMARY KEY);");
+const auto clearValidIds = QStringLiteral("DELETE FROM temp.validIds;");
+const auto insertValidId = QStringLiteral("INSERT OR IGNORE INTO temp.validIds (id) VALUES(?);");
+// the search table is cleaned up through the rowids of deleted items, as its columns are not indexed
+const auto deleteInvalidFromSearch = QStringLiteral(
+    "DELETE FROM search WHERE rowid IN (SELECT id FROM items WHERE id NOT IN (SELECT id FROM temp.validIds));");
+const auto deleteInvalidFromFuzzy = QStringLiteral(
+    "DELETE FROM fuzzy WHERE rowid IN (SELECT id FROM items WHERE id NOT IN (SELECT id FROM temp.validIds));");
+const auto deleteInvalidFromItems = QStringLiteral("DELETE FROM items WHERE id NOT IN (SELECT id FROM temp.validIds);");
 
 } // namespace IndexSQL
 
 
+/// Whether the SQLite engine behind @p db, i.e. the one Qt's driver uses, can hold the index
+bool engineSupported(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(IndexSQL::sqliteVersion) || !query.next())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to query SQLite version: " << query.lastError().text();
+        return false;
+    }
+    if (const auto engine = QVersionNumber::fromString(query.value(0).toString()); engine < MIN_SQLITE_VERSION)
+    {
+        qCCritical(KRunnerZoteroIndex) << "SQLite" << engine.toString() << "is too old for the index, at least"
+            << MIN_SQLITE_VERSION.toString() << "is required. Index not updated.";
+        return false;
+    }
+    return true;
+}
+
 bool Index::setup() const
 {
     /**
     * @brief Setup the index database
     *
+    * Checks that the SQLite engine of Qt's driver, which may not be the one linked at build time, can hold the
+    * search table. If it cannot, the index is left alone and updates are skipped.
+    *
     * @return true if the database was (re-)created, false otherwise
     */
+    const Trace::Span span("Index::setup");
     qCDebug(KRunnerZoteroIndex()) << "Setting up index...";
-    bool do_update = false;
+    bool do_update = true;
     const auto connectionId = QUuid::createUuid().toString();
     {
         auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
@@ -104,264 +299,1134 @@ bool Index::setup() const
             return false;
         }
 
-        bool do_create_tables = true;
-
-        QSqlQuery versionQuery(db);
-        versionQuery.exec(IndexSQL::getVersion);
-        if (versionQuery.next())
+        if (!engineSupported(db))
+        {
+            m_unsupported = true;
+            do_update = false;
+        }
+        else
         {
-            if (versionQuery.value(QStringLiteral("version")).toInt() != DB_VERSION)
+            // readers never wait for the writer in WAL mode, and see every commit atomically
+            if (QSqlQuery walQuery(db); !walQuery.exec(IndexSQL::enableWal))
             {
-                qCInfo(KRunnerZoteroIndex) << "Database version outdated, most recent version is: " << DB_VERSION <<
- " but is "
-                    << versionQuery.value(QStringLiteral("version")).toInt();
+                qCWarning(KRunnerZoteroIndex) << "Failed to enable WAL mode: " << walQuery.lastError().text();
+            }
 
-                if (db.transaction())
-                {
-                    QSqlQuery resetQuery(db);
-                    for (const QString& statement : IndexSQL::reset)
-                    {
-                        resetQuery.exec(statement);
-                    }
-                    if (!db.commit())
-                    {
-                        qCCritical(KRunnerZoteroIndex) << "Failed to commit reset" << db.lastError().text();
-                        db.rollback();
-                        do_create_tables = false;
-                    }
-                    else
-                    {
-                        qCInfo(KRunnerZoteroIndex) << "Reset completed";
-                    }
-                }
-                else
-                {
-                    qCCritical(KRunnerZoteroIndex) << "Failed to start transaction" << db.lastError().text();
-                    do_create_tables = false;
-                }
+            QSqlQuery versionQuery(db);
+            versionQuery.exec(IndexSQL::getVersion);
+            if (!versionQuery.next())
+            {
+                qCInfo(KRunnerZoteroIndex) << "No index yet, building it...";
+            }
+            else if (const int version = versionQuery.value(QStringLiteral("version")).toInt(); version != DB_VERSION)
+            {
+                qCInfo(KRunnerZoteroIndex) << "Database version outdated, most recent version is: " << DB_VERSION << " but is "
+                    << version;
+                versionQuery.finish();
+                // the outdated index stays searchable until it is migrated or the rebuilt one replaces it
+                do_update = !migrate(db, version);
+                m_readPool.invalidate();
             }
             else
             {
-                do_create_tables = false;
+                do_update = false;
+            }
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionId);
+    if (m_unsupported)
+        return false;
+
+    if (!do_update && !itemStore())
+    {
+        qCInfo(KRunnerZoteroIndex) << "Item store missing or outdated, rebuilding index";
+        do_update = true;
+    }
+    else if (!do_update && !buildState(m_dbIndexPath).complete)
+    {
+        qCInfo(KRunnerZoteroIndex) << "Index incomplete, resuming indexing";
+        do_update = true;
+    }
+
+    if (do_update)
+        update(true);
+    return do_update;
+}
+
+bool Index::migrate(QSqlDatabase& db, const int version) const
+{
+    if (version > DB_VERSION || version < IndexSQL::migrations.front().version - 1)
+    {
+        qCInfo(KRunnerZoteroIndex) << "No migration from version" << version << ", rebuilding index";
+        return false;
+    }
+    for (const Migration& migration : IndexSQL::migrations)
+    {
+        if (migration.version <= version)
+            continue;
+        Trace::Span span("Index::migrate");
+        span.arg("version", migration.version);
+        if (!db.transaction())
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to start transaction" << db.lastError().text();
+            return false;
+        }
+        QSqlQuery query(db);
+        bool migrated = true;
+        for (const QString& statement : migration.statements)
+        {
+            if (!query.exec(statement))
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to migrate index to version" << migration.version << ":" << query.lastError().text();
+                migrated = false;
+                break;
             }
         }
+        query.prepare(IndexSQL::setVersion);
+        query.bindValue(0, migration.version);
+        if (!migrated || !query.exec() || !db.commit())
+        {
+            // earlier steps stay committed, the rebuilt index replaces them anyway
+            db.rollback();
+            return false;
+        }
+        qCInfo(KRunnerZoteroIndex) << "Migrated index to version" << migration.version;
+    }
+    return true;
+}
 
-        if (do_create_tables)
+bool Index::createTables(const QString& path, const ZoteroChangeMark& mark) const
+{
+    bool created = false;
+    const auto connectionId = QUuid::createUuid().toString();
+    {
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
+        db.setDatabaseName(path);
+        if (!db.open())
         {
-            qCInfo(KRunnerZoteroIndex) << "Creating tables...";
-            if (db.transaction())
+            qCCritical(KRunnerZoteroIndex) << "Failed to open Index database: " << db.lastError().text();
+        }
+        else if (db.transaction())
+        {
+            QSqlQuery createQuery(db);
+            bool executed = true;
+            for (const QString& statement : IndexSQL::dropTables)
             {
-                QSqlQuery createQuery(db);
-                for (const QString& statement : IndexSQL::createTables)
-                {
-                    createQuery.exec(statement);
-                }
-                if (!db.commit())
+                if (executed && !createQuery.exec(statement))
                 {
-                    qCCritical(KRunnerZoteroIndex) << "Failed to commit create tables" << db.lastError().text();
-                    db.rollback();
+                    qCCritical(KRunnerZoteroIndex) << "Failed to drop tables:" << createQuery.lastError().text();
+                    executed = false;
                 }
-                else
+            }
+            for (const QString& statement : IndexSQL::createTables)
+            {
+                if (executed && !createQuery.exec(statement))
                 {
-                    qCInfo(KRunnerZoteroIndex) << "Tables created";
-                    do_update = true;
+                    qCCritical(KRunnerZoteroIndex) << "Failed to create tables:" << createQuery.lastError().text();
+                    executed = false;
                 }
             }
+            created = executed && db.commit();
+            if (!executed)
+            {
+                db.rollback();
+            }
+            else if (!created)
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to commit create tables" << db.lastError().text();
+                db.rollback();
+            }
             else
             {
-                qCCritical(KRunnerZoteroIndex) << "Failed to start transaction" << db.lastError().text();
+                // remembers where the build started, should it be resumed from a later snapshot
+                created = storeChangeMark(db, mark, false);
             }
         }
+        else
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to start transaction" << db.lastError().text();
+        }
     }
     QSqlDatabase::removeDatabase(connectionId);
+    return created;
+}
 
-    if (do_update)
-        update(true);
-    return do_update;
+bool Index::replaceWithShadow() const
+{
+    /*
+     * Renaming the shadow over the live file would pair it with the live index's WAL and shared
+     * memory, which connections still have open. Its pages are copied into the live index in a
+     * single write transaction instead: readers keep their snapshot of the old index until the
+     * copy commits and see the new one with their next query. The live index stays in WAL mode,
+     * which the backup keeps for its destination. Both ends are opened with the linked SQLite
+     * library, which update() only rebuilds in a shadow for if Qt's driver uses that library as
+     * well: a copy of its own would not see the locks taken here, and closing the handles here
+     * would drop its locks on the same files.
+     */
+    bool replaced = false;
+    sqlite3* live = nullptr;
+    sqlite3* shadow = nullptr;
+    const QByteArray livePath = m_dbIndexPath.toUtf8();
+    const QByteArray shadowPath = m_shadowPath.toUtf8();
+    if (sqlite3_open_v2(livePath.constData(), &live, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to open index for swap: " << sqlite3_errmsg(live);
+    }
+    else if (sqlite3_open_v2(shadowPath.constData(), &shadow, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to open shadow index for swap: " << sqlite3_errmsg(shadow);
+    }
+    else if (sqlite3_backup* backup = sqlite3_backup_init(live, "main", shadow, "main"); backup == nullptr)
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to start swap: " << sqlite3_errmsg(live);
+    }
+    else
+    {
+        // an incremental update of another Index on the same file may hold the write lock
+        sqlite3_busy_timeout(live, SWAP_BUSY_TIMEOUT_MS);
+        const int stepResult = sqlite3_backup_step(backup, -1);
+        const int finishResult = sqlite3_backup_finish(backup);
+        replaced = stepResult == SQLITE_DONE && finishResult == SQLITE_OK;
+        if (!replaced)
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to swap in the rebuilt index: " << sqlite3_errstr(stepResult == SQLITE_DONE ? finishResult : stepResult);
+        }
+    }
+    // both are safe to call with nullptr, and a failed open still allocates a handle
+    sqlite3_close(shadow);
+    sqlite3_close(live);
+    removeShadow();
+    return replaced;
 }
 
-QDateTime Index::last_modified() const { return QFileInfo(m_dbIndexPath).lastModified(); }
+void Index::removeShadow() const
+{
+    for (const auto& suffix : {QStringLiteral(""), QStringLiteral("-journal"), QStringLiteral("-wal"), QStringLiteral("-shm"),
+                               QStringLiteral(".items"), QStringLiteral(".items.new")})
+    {
+        QFile::remove(m_shadowPath + suffix);
+    }
+}
 
-bool Index::needs_update() const { return m_zotero.lastModified() > last_modified(); }
+Index::BuildState Index::buildState(const QString& path) const
+{
+    BuildState state;
+    if (!QFile::exists(path))
+        return state;
+    const auto connectionId = QUuid::createUuid().toString();
+    {
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
+        db.setDatabaseName(path);
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        if (!db.open())
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to open Index database: " << db.lastError().text();
+        }
+        else if (QSqlQuery query(db); query.exec(IndexSQL::getBuildState) && query.next())
+        {
+            // indexes written before change marks existed have none, and are brought up to date with a full pass
+            if (!query.isNull(0))
+            {
+                state.mark = ZoteroChangeMark{.clientDateModified = query.value(0).toString(),
+                                              .version = query.value(1).toLongLong(),
+                                              .libraryVersion = query.value(2).toLongLong(),
+                                              .itemCount = query.value(3).toLongLong(),
+                                              .trashedCount = query.value(4).toLongLong()};
+            }
+            state.version = query.value(5).toInt();
+            // indexes written before builds were checkpointed only stored a mark once they were complete
+            state.complete = query.isNull(6) ? state.mark.has_value() : query.value(6).toInt() != 0;
+            if (!query.isNull(7))
+                state.checkpoint = query.value(7).toInt();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionId);
+    return state;
+}
+
+bool Index::storeChangeMark(QSqlDatabase& db, const ZoteroChangeMark& mark, const bool complete) const
+{
+    if (!db.transaction())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to start transaction: " << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(IndexSQL::setInfo);
+    for (const auto& [key, value] : {std::pair{QStringLiteral("zoteroClientDateModified"), QVariant(mark.clientDateModified)},
+                                     std::pair{QStringLiteral("zoteroVersion"), QVariant(mark.version)},
+                                     std::pair{QStringLiteral("zoteroLibraryVersion"), QVariant(mark.libraryVersion)},
+                                     std::pair{QStringLiteral("zoteroItemCount"), QVariant(mark.itemCount)},
+                                     std::pair{QStringLiteral("zoteroTrashedCount"), QVariant(mark.trashedCount)},
+                                     std::pair{QStringLiteral("complete"), QVariant(complete ? 1 : 0)}})
+    {
+        query.bindValue(0, key);
+        query.bindValue(1, value);
+        if (!query.exec())
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to store change mark: " << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    if (complete && !query.exec(IndexSQL::clearCheckpoint))
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to clear checkpoint: " << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to commit change mark: " << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+// moves @p newPath over @p path in one step, which QFile::rename() refuses to do
+bool replaceFile(const QString& newPath, const QString& path)
+{
+    return std::rename(QFile::encodeName(newPath).constData(), QFile::encodeName(path).constData()) == 0;
+}
 
-QVariant getOrNull(const std::unordered_map<std::string, std::string>& m, const std::string& key)
+QVariant getOrNull(const ZoteroItem& item, const ZoteroField field)
 {
-    if (const auto it = m.find(key); it != m.end())
+    if (const auto value = item.field(field); !value.empty())
     {
-        return QString::fromStdString(it->second);
+        return QString::fromUtf8(value);
     }
     return {};
 }
 
-void Index::update(const bool force) const
+void Index::update(bool force) const
 {
-    if (!force && !needs_update())
+    Trace::Span span("Index::update");
+    if (m_unsupported)
+    {
+        qCDebug(KRunnerZoteroIndex) << "SQLite too old for the index, not updated.";
+        return;
+    }
+    const BuildState live = buildState(m_dbIndexPath);
+    // without a store to copy unchanged items from, everything has to be extracted again, as it has to be
+    // for an index whose first build never completed
+    force = force || !itemStore() || !live.complete;
+    span.arg("force", force);
+
+    // the change mark, items and valid keys are all read from the same snapshot of the Zotero database
+    const auto snapshot = m_zotero.snapshot();
+    if (!snapshot.isOpen())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to open Zotero database, index not updated.";
+        return;
+    }
+    auto mark = Zotero::changeMark(snapshot);
+    if (!mark.has_value())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to read Zotero change mark, index not updated.";
+        return;
+    }
+    const auto since = force ? std::nullopt : live.mark;
+    if (!force && since == mark)
     {
         qCDebug(KRunnerZoteroIndex) << "Index is up to date.";
         return;
     }
 
     qCInfo(KRunnerZoteroIndex) << "Updating index...";
-    qCDebug(KRunnerZoteroIndex()) << "Last update of index: " << last_modified().toString();
-    qCDebug(KRunnerZoteroIndex()) << "Last update of Zotero: " << m_zotero.lastModified().toString();
+    if (since.has_value())
+    {
+        qCDebug(KRunnerZoteroIndex) << "Index is up to date with" << since->clientDateModified << "version" << since->version
+            << ", Zotero is at" << mark->clientDateModified << "version" << mark->version;
+    }
+
+    // A complete index is rebuilt in a shadow index, so searches keep using it until the new one is complete. An
+    // index that was never complete is built in place instead, so it serves the items indexed so far. So is one
+    // whose shadow could not be swapped in safely, see replaceWithShadow(). Either build commits a checkpoint with
+    // every batch and resumes from it after an interruption.
+    const bool shadow = force && live.complete && ConnectionPool::driverUsesLinkedSqlite();
+    if (force && live.complete && !shadow)
+    {
+        qCInfo(KRunnerZoteroIndex) << "Qt's SQLite driver does not use the linked SQLite library, rebuilding the index in place.";
+    }
+    const QString& target = shadow ? m_shadowPath : m_dbIndexPath;
+    const QString targetStorePath = shadow ? m_shadowPath + QStringLiteral(".items") : m_itemStorePath;
+    const auto writeTarget = !force ? WriteTarget::Incremental : shadow ? WriteTarget::ShadowBuild : WriteTarget::InPlaceBuild;
+    std::optional<BuildState> resumed;
+    // the items of an interrupted build, which the resumed one starts its store with
+    std::shared_ptr<const ItemStore> resumedStore;
+    int resumeAfter = 0;
+    if (force)
+    {
+        if (auto state = shadow ? buildState(m_shadowPath) : live;
+            state.version == DB_VERSION && !state.complete && state.checkpoint.has_value() && state.mark.has_value()
+            && (resumedStore = ItemStore::open(targetStorePath)))
+        {
+            // the store is written after every checkpoint, so it only lags behind the index if writing it failed;
+            // items past it are read again
+            const std::size_t stored = resumedStore->size();
+            resumeAfter = std::min(state.checkpoint.value(), stored == 0 ? 0 : resumedStore->at(stored - 1).rowid());
+            qCInfo(KRunnerZoteroIndex) << "Resuming indexing after item" << resumeAfter;
+            resumed = std::move(state);
+        }
+        else
+        {
+            // a shadow that cannot be resumed starts over from an empty file, which also gets rid of one that a
+            // power loss corrupted, as it is written without syncs
+            if (shadow)
+                removeShadow();
+            if (!createTables(target, mark.value()))
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to create index tables, index not updated.";
+                return;
+            }
+            if (!shadow)
+            {
+                // statements prepared against the old tables must not be reused
+                m_readPool.invalidate();
+            }
+        }
+    }
+    // changed items go into a new item store, unchanged ones are copied over below
+    const auto oldStore = !force ? itemStore() : nullptr;
+
+    // Items flow through a pipeline of bounded queues: this thread fetches rows from the snapshot, the
+    // decoders parse their JSON in parallel and a single writer inserts them in batches. The snapshot's
+    // connection may only be used by this thread, the index connection only by the writer.
+    const int decoders = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 2, 1, MAX_DECODERS);
+    BoundedQueue<RowChunk> rowQueue(2 * decoders);
+    ItemQueue itemQueue(2 * decoders);
+
+    ItemStoreWriter storeWriter;
+    if (resumedStore)
+    {
+        // a full build writes its store with every checkpoint, which has to include the items indexed before
+        for (std::size_t i = 0; i < resumedStore->size() && resumedStore->at(i).rowid() <= resumeAfter; ++i)
+        {
+            storeWriter.add(resumedStore->at(i));
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
+    std::optional<int> written;
+    bool interrupted = false;
+    {
+        const std::jthread writer([&]()
+        {
+            QThread::currentThread()->setObjectName(QStringLiteral("zotero-writer"));
+            written = writeItems(itemQueue, target, writeTarget, storeWriter, targetStorePath);
+        });
+        std::vector<std::jthread> decoderThreads;
+        for (int i = 0; i < decoders; ++i)
+        {
+            decoderThreads.emplace_back([&rowQueue, &itemQueue]()
+            {
+                QThread::currentThread()->setObjectName(QStringLiteral("zotero-decoder"));
+                while (auto rows = rowQueue.pop())
+                {
+                    Trace::Span decodeSpan("decode batch");
+                    decodeSpan.arg("rows", static_cast<std::int64_t>(rows->rows.size()));
+                    // each chunk is decoded into its own batch, which frees all of its strings at once once written
+                    ItemChunk items{.sequence = rows->sequence, .lastId = rows->rows.back().id, .items = {}};
+                    for (const auto& row : rows->rows)
+                    {
+                        try
+                        {
+                            Zotero::decode(row, items.items);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            qCWarning(KRunnerZoteroIndex) << "Failed to decode item" << row.id << ":" << e.what();
+                            Stats::add(Stats::Counter::DecodeErrors);
+                        }
+                    }
+                    if (!itemQueue.push(std::move(items)))
+                    {
+                        // the writer gave up, so stop fetching as well
+                        rowQueue.close();
+                        return;
+                    }
+                }
+            });
+        }
+
+        RowChunk chunk;
+        // one span per chunk, without the time spent waiting for a decoder to take it
+        std::optional<Trace::Span> fetchSpan(std::in_place, "fetch batch");
+        try
+        {
+            for (ZoteroRow&& row : Zotero::rows(snapshot, since, resumeAfter))
+            {
+                // e.g. the runner is being unloaded
+                if (QThread::currentThread()->isInterruptionRequested())
+                {
+                    interrupted = true;
+                    break;
+                }
+                chunk.rows.push_back(std::move(row));
+                if (chunk.rows.size() >= PIPELINE_CHUNK_SIZE)
+                {
+                    fetchSpan->arg("rows", static_cast<std::int64_t>(chunk.rows.size()));
+                    fetchSpan.reset();
+                    const std::size_t next = chunk.sequence + 1;
+                    if (!rowQueue.push(std::exchange(chunk, RowChunk{.sequence = next, .rows = {}})))
+                        break;
+                    fetchSpan.emplace("fetch batch");
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            // The rows read so far are still written, but without all of them the update must neither store its
+            // mark nor replace the store or the index. It ends like an interrupted one, so a full build keeps its
+            // checkpoint and the next update reads the rest again.
+            qCCritical(KRunnerZoteroIndex) << "Failed to read items from Zotero:" << e.what();
+            interrupted = true;
+        }
+        if (fetchSpan.has_value())
+        {
+            fetchSpan->arg("rows", static_cast<std::int64_t>(chunk.rows.size()));
+            fetchSpan.reset();
+        }
+        if (!chunk.rows.empty())
+            rowQueue.push(std::move(chunk));
+        rowQueue.close();
+        for (auto& decoder : decoderThreads)
+            decoder.join();
+        itemQueue.close();
+    }
+    if (!written.has_value())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to write items, index not updated.";
+        return;
+    }
+    const int inserted = written.value();
+
+    const auto elapsed = timer.elapsed();
+    qCInfo(KRunnerZoteroIndex) << "Indexed" << inserted << "item(s) in" << elapsed << "ms using" << decoders << "decoder(s)"
+        << QStringLiteral("(%1 items/s)").arg(elapsed > 0 ? inserted * 1000.0 / static_cast<double>(elapsed) : 0.0, 0, 'f', 1);
+
+    // items only disappear from the index if Zotero deleted or (un)trashed some, or if keys moved to new items
+    const bool collect = !interrupted && (!since.has_value() || inserted > 0 || since->itemCount != mark->itemCount
+                                          || since->trashedCount != mark->trashedCount);
+    const auto validIds = collect ? Zotero::validIds(snapshot) : std::vector<int>();
+    int removed = 0;
+    const QString& storePath = shadow && interrupted ? targetStorePath : m_itemStorePath;
+    const QString newStorePath = storePath + QStringLiteral(".new");
+    bool storeReplaced = false;
+    bool failed = false;
     const auto connectionId = QUuid::createUuid().toString();
     {
         auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
-        db.setDatabaseName(m_dbIndexPath);
+        db.setDatabaseName(target);
         if (!db.open())
         {
             qCCritical(KRunnerZoteroIndex) << "Failed to open Index database: " << db.lastError().text();
             return;
         }
 
-        QDateTime last_modified_dt;
-        if (force) {
-            // earliest date possible, so all items are returned
-            last_modified_dt = QDateTime(QDate(1970, 1, 1), QTime(0, 0));
+        if (interrupted) {
+            qCInfo(KRunnerZoteroIndex) << "Update interrupted, the remaining items will be indexed next time.";
+        } else if (!collect) {
+            qCDebug(KRunnerZoteroIndex) << "No items were deleted.";
+        } else if (validIds.empty()) {
+            qCWarning(KRunnerZoteroIndex) << "Failed to get valid IDs or Zotero database empty.";
         } else {
-            last_modified_dt = last_modified();
-        }
-
-        for (const ZoteroItem &&item : m_zotero.items(last_modified_dt)) {
-            if (db.transaction())
-            {
-                QSqlQuery metaQuery(db);
-                metaQuery.prepare(IndexSQL::insertOrReplaceSearch);
-
-                metaQuery.bindValue(QStringLiteral(":rowid"), item.id);
-                metaQuery.bindValue(QStringLiteral(":key"), QString::fromStdString(item.key));
-                metaQuery.bindValue(QStringLiteral(":title"), getOrNull(item.meta, "title"));
-                metaQuery.bindValue(QStringLiteral(":shortTitle"), getOrNull(item.meta, "shortTitle"));
-                metaQuery.bindValue(QStringLiteral(":doi"), getOrNull(item.meta, "DOI"));
-                metaQuery.bindValue(QStringLiteral(":abstract"), getOrNull(item.meta, "abstractNote"));
-                metaQuery.bindValue(QStringLiteral(":year"), item.year());
-                std::vector<std::string> publishers;
-                for (const auto publisherKey : {
-                         "publisher", "journalAbbreviation", "conferenceName",
-                         "proceedingsTitle", "websiteTitle"
-                     })
+            const Stats::Timer timer(Stats::Phase::Collect);
+            removed = removeDeleted(db, validIds);
+            Stats::add(Stats::Counter::ItemsDeleted, removed);
+        }
+
+        if (!interrupted && (force || inserted + removed >= MERGE_THRESHOLD))
+        {
+            optimize(db, force);
+        }
+        // nobody reads the shadow yet, and a compact one is quicker to copy into the index
+        if (!interrupted && shadow)
+        {
+            if (QSqlQuery vacuumQuery(db); !vacuumQuery.exec(IndexSQL::vacuum))
+            {
+                qCWarning(KRunnerZoteroIndex) << "Failed to vacuum shadow index: " << vacuumQuery.lastError().text();
+            }
+        }
+
+        // The item store replaces the old one before the mark is stored, and before the shadow replaces the
+        // index. A store ahead of the mark only makes the next update repeat this one, whereas a mark ahead of
+        // the store would have it take the stale store for current, so a store that failed to write or replace
+        // the old one leaves the old mark.
+        // An interrupted full build keeps its items as well, so an index built in place can serve them meanwhile.
+        if (interrupted && !force)
+        {
+            qCDebug(KRunnerZoteroIndex) << "Item store not updated.";
+        }
+        else if (!force && oldStore && inserted == 0 && removed == 0)
+        {
+            qCDebug(KRunnerZoteroIndex) << "Item store is up to date.";
+        }
+        else
+        {
+            if (oldStore)
+            {
+                const std::unordered_set<int> valid(validIds.begin(), validIds.end());
+                for (std::size_t i = 0; i < oldStore->size(); ++i)
                 {
-                    if (const auto it = item.meta.find(publisherKey); it != item.meta.end())
+                    if (const auto oldItem = oldStore->at(i); valid.empty() || valid.contains(oldItem.rowid()))
                     {
-                        publishers.emplace_back(it->second);
+                        storeWriter.add(oldItem);
                     }
                 }
-                metaQuery.bindValue(QStringLiteral(":publisher"), QString::fromStdString(join(publishers)));
-                metaQuery.bindValue(QStringLiteral(":authors"), QString::fromStdString(join(item.authors)));
-                metaQuery.bindValue(QStringLiteral(":tags"), QString::fromStdString(join(item.tags)));
-                metaQuery.bindValue(QStringLiteral(":collections"), QString::fromStdString(join(item.collections)));
-                metaQuery.bindValue(QStringLiteral(":notes"), QString::fromStdString(join(item.note)));
-
-                if (!metaQuery.exec())
-                {
-                    qCCritical(KRunnerZoteroIndex) << "Failed to insert or replace item in Index (meta): " << metaQuery.lastError().text();
-                    db.rollback();
-                    metaQuery.finish();
-                    continue;
-                }
-                metaQuery.finish();
-
-                QSqlQuery dataQuery(db);
-                dataQuery.prepare(IndexSQL::insertOrReplaceData);
-                dataQuery.bindValue(QStringLiteral(":key"), QString::fromStdString(item.key));
-                json j = item;
-                dataQuery.bindValue(QStringLiteral(":obj"), QString::fromStdString(j.dump()));
-                if (!dataQuery.exec() || !db.commit())
-                {
-                    qCCritical(KRunnerZoteroIndex) << "Failed to insert or replace data in Index (data): " << dataQuery.lastError().text();
-                    db.rollback();
-                    dataQuery.finish();
-                    continue;
-                }
-                dataQuery.finish();
-                qCDebug(KRunnerZoteroIndex) << "Inserted item " << item.id << item.key;
+            }
+            if (!storeWriter.write(newStorePath))
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to write item store, index not updated.";
+                failed = true;
+            }
+            else if (!replaceFile(newStorePath, storePath))
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to replace item store" << storePath << ", index not updated.";
+                QFile::remove(newStorePath);
+                failed = true;
             }
             else
             {
-                qCCritical(KRunnerZoteroIndex) << "Failed to start transaction: " << db.lastError().text();
+                storeReplaced = true;
             }
         }
 
-        if (const auto validKeys = m_zotero.validKeys(); validKeys.empty()) {
-            qCWarning(KRunnerZoteroIndex) << "Failed to get valid IDs or Zotero database empty.";
-        } else {
-            // add double quotes around each key
-            std::vector<std::string> quotedKeys;
-            quotedKeys.reserve(validKeys.size());
-            for (const auto &key : validKeys) {
-                quotedKeys.push_back('"' + key + '"');
+        // after an interruption the old mark or the checkpoint stays, so the next update picks up where this one stopped
+        if (!interrupted && !failed)
+        {
+            if (resumed.has_value())
+            {
+                // the items before the checkpoint were read from an earlier snapshot, so the next update reads
+                // everything changed since that one's mark again
+                qCInfo(KRunnerZoteroIndex) << "Resumed indexing completed, scheduling an update of the items changed meanwhile.";
+                mark = resumed->mark;
+                mark->itemCount = -1;
             }
-
-            if (QSqlQuery deleteQuerySearch(db); !deleteQuerySearch.exec(IndexSQL::deleteKeysNotInSearch.arg(QString::fromStdString(join(quotedKeys, ','))))) {
-                qCCritical(KRunnerZoteroIndex) << "Failed to delete invalid IDs: " << deleteQuerySearch.lastError().text();
-            } else {
-                qCDebug(KRunnerZoteroIndex) << "Deleted " << deleteQuerySearch.numRowsAffected() << " record(s) from search table.";
+            else if (!snapshot.unchanged())
+            {
+                // a write in the very second of the mark would not move it, so make sure the mark never matches
+                // and the next update reads everything since then again
+                qCInfo(KRunnerZoteroIndex) << "Zotero database changed during update, scheduling another one.";
+                mark->itemCount = -1;
             }
-            if (QSqlQuery deleteQueryData(db); !deleteQueryData.exec(IndexSQL::deleteKeysNotInData.arg(QString::fromStdString(join(quotedKeys, ','))))) {
-                qCCritical(KRunnerZoteroIndex) << "Failed to delete invalid IDs: " << deleteQueryData.lastError().text();
-            } else {
-                qCDebug(KRunnerZoteroIndex) << "Deleted " << deleteQueryData.numRowsAffected() << " record(s) from data table.";
+            if (!storeChangeMark(db, mark.value(), true))
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to store change mark, index not updated.";
+                failed = true;
             }
         }
     }
     QSqlDatabase::removeDatabase(connectionId);
+
+    // searches switch to the new store even if the rest failed, it is never behind the index's mark
+    if (storeReplaced && storePath == m_itemStorePath)
+    {
+        m_itemStore.store(ItemStore::open(m_itemStorePath));
+    }
+
+    // the shadow of an interrupted rebuild stays, with the items indexed so far, until the rebuild is resumed
+    if (failed || (shadow && !interrupted && !replaceWithShadow()))
+    {
+        return;
+    }
+    if (shadow && !interrupted)
+    {
+        // statements prepared against the old tables must not be reused
+        m_readPool.invalidate();
+    }
+
     qCDebug(KRunnerZoteroIndex) << "Index successfully updated";
 }
 
-std::vector<std::pair<ZoteroItem, float>> Index::search(QString&& needle) const
+std::optional<int> Index::writeItems(ItemQueue& items, const QString& path, const WriteTarget target, ItemStoreWriter& storeWriter,
+                                     const QString& storePath) const
 {
+    std::optional<int> inserted;
     const auto connectionId = QUuid::createUuid().toString();
-
-    // escape all double quotes in needle
-    needle.replace(QStringLiteral("\""), QStringLiteral("\"\""));
-    needle.prepend(QStringLiteral("\""));
-    needle.append(QStringLiteral("\""));
-    std::vector<std::pair<ZoteroItem, float>> result;
     {
-        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
-        db.setDatabaseName(m_dbIndexPath);
-        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionId);
+        db.setDatabaseName(path);
         if (!db.open())
         {
             qCCritical(KRunnerZoteroIndex) << "Failed to open Index database: " << db.lastError().text();
-            return {};
         }
-        QSqlQuery query(db);
-        query.prepare(IndexSQL::search);
-        query.addBindValue(needle);
-        if (!query.exec())
+        else
         {
-            qCCritical(KRunnerZoteroIndex) << "Failed to search Index: " << query.lastError().text();
-            qCCritical(KRunnerZoteroIndex) << "with query" << query.lastQuery();
-            return {};
+            inserted = writeItems(db, items, target, storeWriter, storePath);
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionId);
+    // unblock the decoders if writing failed
+    items.close();
+    return inserted;
+}
+
+std::optional<int> Index::writeItems(QSqlDatabase& db, ItemQueue& items, const WriteTarget target, ItemStoreWriter& storeWriter,
+                                     const QString& storePath) const
+{
+    // A full build commits a checkpoint with every batch and stays in WAL mode, so a crash only loses the batches
+    // after the last checkpoint. With synchronous = NORMAL that holds for a power loss as well, whereas OFF may
+    // corrupt the file then, even in WAL mode. Only the shadow skips the syncs: nobody reads it, and the next build
+    // starts it over if it cannot be resumed.
+    const bool bulkLoad = target != WriteTarget::Incremental;
+    QSqlQuery pragmaQuery(db);
+    for (const QString& statement : bulkLoad ? IndexSQL::bulkLoadPragmas : IndexSQL::incrementalPragmas)
+    {
+        if (!pragmaQuery.exec(statement))
+        {
+            qCWarning(KRunnerZoteroIndex) << "Failed to set" << statement << ":" << pragmaQuery.lastError().text();
+        }
+    }
+    if (target == WriteTarget::ShadowBuild && !pragmaQuery.exec(IndexSQL::disableSync))
+    {
+        qCWarning(KRunnerZoteroIndex) << "Failed to set" << IndexSQL::disableSync << ":" << pragmaQuery.lastError().text();
+    }
+
+    // statements are prepared once and rebound for every item
+    QSqlQuery metaQuery(db);
+    QSqlQuery fuzzyQuery(db);
+    QSqlQuery itemQuery(db);
+    QSqlQuery savepointQuery(db);
+    QSqlQuery releaseQuery(db);
+    QSqlQuery rollbackToQuery(db);
+    if (!metaQuery.prepare(IndexSQL::insertOrReplaceSearch) || !fuzzyQuery.prepare(IndexSQL::insertOrReplaceFuzzy)
+        || !itemQuery.prepare(IndexSQL::insertOrReplaceItem)
+        || !savepointQuery.prepare(IndexSQL::savepointItem) || !releaseQuery.prepare(IndexSQL::releaseItem)
+        || !rollbackToQuery.prepare(IndexSQL::rollbackToItem))
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to prepare insert statements: " << db.lastError().text();
+        return std::nullopt;
+    }
+
+    // Chunks arrive in any order from the decoders. A full build commits the last item ID up to which every chunk
+    // was written along with each batch, so an interrupted build can resume from there.
+    std::size_t nextSequence = 0;
+    std::map<std::size_t, int> pendingChunks;
+    std::optional<int> checkpoint;
+    QSqlQuery checkpointQuery(db);
+    checkpointQuery.prepare(IndexSQL::setInfo);
+
+    int inserted = 0;
+    int pending = 0;
+    // The chunks of the open batch stay alive until it is committed, and only then are its items counted and
+    // added to the store, which must never hold items the index lost to a rollback.
+    std::vector<ItemChunk> batchChunks;
+    std::vector<const ZoteroItem*> batchItems;
+    const auto commitBatch = [&]()
+    {
+        if (pending == 0)
+            return true;
+        const Stats::Timer timer(Stats::Phase::Commit);
+        if (bulkLoad && checkpoint.has_value())
+        {
+            checkpointQuery.bindValue(0, QStringLiteral("checkpoint"));
+            checkpointQuery.bindValue(1, checkpoint.value());
+            if (!checkpointQuery.exec())
+            {
+                qCWarning(KRunnerZoteroIndex) << "Failed to store checkpoint: " << checkpointQuery.lastError().text();
+            }
+        }
+        if (!db.commit())
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to commit batch of" << pending << "item(s): " << db.lastError().text();
+            db.rollback();
+            return false;
+        }
+        for (const ZoteroItem* item : batchItems)
+        {
+            storeWriter.add(*item);
+        }
+        inserted += static_cast<int>(batchItems.size());
+        Stats::add(Stats::Counter::ItemsInserted, static_cast<std::int64_t>(batchItems.size()));
+        batchItems.clear();
+        batchChunks.clear();
+        pending = 0;
+        // The store goes with the checkpoint, so a build that gets killed resumes from what is on disk, and one
+        // in place serves the items indexed so far. A store that failed to write only makes the resumed build
+        // read the items past it again.
+        if (bulkLoad && checkpoint.has_value())
+        {
+            if (!storeWriter.write(storePath))
+            {
+                qCWarning(KRunnerZoteroIndex) << "Failed to write item store with checkpoint" << checkpoint.value();
+            }
+            else if (target == WriteTarget::InPlaceBuild)
+            {
+                m_itemStore.store(ItemStore::open(storePath));
+            }
         }
+        return true;
+    };
 
-        while (query.next())
+    while (auto chunk = items.pop())
+    {
+        Trace::Span writeSpan("write batch");
+        writeSpan.arg("items", static_cast<std::int64_t>(chunk->items.size()));
+        for (const ZoteroItem& item : chunk->items)
         {
-            const auto key = query.value(QStringLiteral("key")).toString();
-            const auto score = query.value(QStringLiteral("score")).toFloat();
-            QSqlQuery dataQuery(db);
-            dataQuery.prepare(IndexSQL::selectData);
-            dataQuery.addBindValue(key);
-            dataQuery.exec();
-            if (!dataQuery.exec())
+            if (pending == 0 && !db.transaction())
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to start transaction: " << db.lastError().text();
+                return std::nullopt;
+            }
+            const auto insertStart = Stats::Clock::now();
+            // one savepoint per item keeps search and items consistent without a commit per item
+            savepointQuery.exec();
+
+            metaQuery.bindValue(QStringLiteral(":rowid"), item.id);
+            metaQuery.bindValue(QStringLiteral(":key"), QString::fromUtf8(item.key));
+            metaQuery.bindValue(QStringLiteral(":title"), getOrNull(item, ZoteroField::title));
+            metaQuery.bindValue(QStringLiteral(":shortTitle"), getOrNull(item, ZoteroField::shortTitle));
+            metaQuery.bindValue(QStringLiteral(":doi"), getOrNull(item, ZoteroField::DOI));
+            metaQuery.bindValue(QStringLiteral(":abstract"), getOrNull(item, ZoteroField::abstractNote));
+            metaQuery.bindValue(QStringLiteral(":year"), item.year());
+            std::vector<std::string_view> publishers;
+            for (const auto publisherField : {
+                     ZoteroField::publisher, ZoteroField::journalAbbreviation, ZoteroField::conferenceName,
+                     ZoteroField::proceedingsTitle, ZoteroField::websiteTitle
+                 })
+            {
+                if (const auto value = item.field(publisherField); !value.empty())
+                {
+                    publishers.push_back(value);
+                }
+            }
+            metaQuery.bindValue(QStringLiteral(":publisher"), join(std::span<const std::string_view>(publishers)));
+            metaQuery.bindValue(QStringLiteral(":authors"), join(item.authors));
+            metaQuery.bindValue(QStringLiteral(":tags"), join(item.tags));
+            metaQuery.bindValue(QStringLiteral(":collections"), join(item.collections));
+            metaQuery.bindValue(QStringLiteral(":notes"), join(item.note));
+
+            fuzzyQuery.bindValue(QStringLiteral(":rowid"), item.id);
+            fuzzyQuery.bindValue(QStringLiteral(":title"), QString::fromUtf8(item.displayTitle()));
+            fuzzyQuery.bindValue(QStringLiteral(":authors"), join(item.authors, ','));
+            fuzzyQuery.bindValue(QStringLiteral(":doi"), getOrNull(item, ZoteroField::DOI));
+
+            itemQuery.bindValue(QStringLiteral(":id"), item.id);
+            itemQuery.bindValue(QStringLiteral(":key"), QString::fromUtf8(item.key));
+
+            if (!metaQuery.exec())
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to insert or replace item in Index (meta): " << metaQuery.lastError().text();
+                rollbackToQuery.exec();
+            }
+            else if (!fuzzyQuery.exec())
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to insert or replace item in Index (fuzzy): " << fuzzyQuery.lastError().text();
+                rollbackToQuery.exec();
+            }
+            else if (!itemQuery.exec())
+            {
+                qCCritical(KRunnerZoteroIndex) << "Failed to insert or replace item in Index (items): " << itemQuery.lastError().text();
+                rollbackToQuery.exec();
+            }
+            else
             {
-                qCCritical(KRunnerZoteroIndex) << "Failed to get data for item " << key << ": " << dataQuery.lastError().text();
-                continue;
+                batchItems.push_back(&item);
+                qCDebug(KRunnerZoteroIndex) << "Inserted item " << item.id << QString::fromUtf8(item.key);
             }
-            if (dataQuery.next())
+            releaseQuery.exec();
+            Stats::record(Stats::Phase::Insert, Stats::Clock::now() - insertStart);
+            ++pending;
+        }
+
+        pendingChunks.emplace(chunk->sequence, chunk->lastId);
+        for (auto it = pendingChunks.begin(); it != pendingChunks.end() && it->first == nextSequence; it = pendingChunks.erase(it))
+        {
+            checkpoint = it->second;
+            ++nextSequence;
+        }
+        // moving the chunk keeps its items where they are
+        batchChunks.push_back(std::move(chunk.value()));
+        // batches end with a chunk, so a checkpoint never falls into the middle of one
+        if (pending >= UPDATE_BATCH_SIZE && !commitBatch())
+            return std::nullopt;
+    }
+    if (!commitBatch())
+        return std::nullopt;
+    return inserted;
+}
+
+void Index::optimize(QSqlDatabase& db, const bool full) const
+{
+    Trace::Span span(full ? "optimize" : "merge");
+    QSqlQuery query(db);
+    for (const QString& statement : full ? IndexSQL::optimize : IndexSQL::merge)
+    {
+        if (!query.exec(statement))
+        {
+            qCWarning(KRunnerZoteroIndex) << "Failed to run" << statement << ":" << query.lastError().text();
+        }
+    }
+}
+
+std::shared_ptr<const ItemStore> Index::itemStore() const
+{
+    auto store = m_itemStore.load();
+    if (!store)
+    {
+        // racing threads may both map the store, which is harmless
+        store = ItemStore::open(m_itemStorePath);
+        m_itemStore.store(store);
+    }
+    return store;
+}
+
+int Index::removeDeleted(QSqlDatabase& db, const std::vector<int>& validIds) const
+{
+    if (!db.transaction())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to start transaction: " << db.lastError().text();
+        return 0;
+    }
+
+    QSqlQuery query(db);
+    query.exec(IndexSQL::createValidIds);
+    query.exec(IndexSQL::clearValidIds);
+    QSqlQuery insertQuery(db);
+    insertQuery.prepare(IndexSQL::insertValidId);
+    for (const int id : validIds)
+    {
+        insertQuery.bindValue(0, id);
+        if (!insertQuery.exec())
+        {
+            qCCritical(KRunnerZoteroIndex) << "Failed to collect valid IDs: " << insertQuery.lastError().text();
+            db.rollback();
+            return 0;
+        }
+    }
+
+    if (QSqlQuery deleteQuerySearch(db); !deleteQuerySearch.exec(IndexSQL::deleteInvalidFromSearch)) {
+        qCCritical(KRunnerZoteroIndex) << "Failed to delete invalid IDs: " << deleteQuerySearch.lastError().text();
+    } else {
+        qCDebug(KRunnerZoteroIndex) << "Deleted " << deleteQuerySearch.numRowsAffected() << " record(s) from search table.";
+    }
+    if (QSqlQuery deleteQueryFuzzy(db); !deleteQueryFuzzy.exec(IndexSQL::deleteInvalidFromFuzzy)) {
+        qCCritical(KRunnerZoteroIndex) << "Failed to delete invalid IDs: " << deleteQueryFuzzy.lastError().text();
+    }
+    int removed = 0;
+    if (QSqlQuery deleteQueryItems(db); !deleteQueryItems.exec(IndexSQL::deleteInvalidFromItems)) {
+        qCCritical(KRunnerZoteroIndex) << "Failed to delete invalid IDs: " << deleteQueryItems.lastError().text();
+    } else {
+        removed = deleteQueryItems.numRowsAffected();
+        qCDebug(KRunnerZoteroIndex) << "Deleted " << removed << " record(s) from items table.";
+    }
+    query.exec(IndexSQL::clearValidIds);
+
+    if (!db.commit())
+    {
+        qCCritical(KRunnerZoteroIndex) << "Failed to commit deletions: " << db.lastError().text();
+        db.rollback();
+        return 0;
+    }
+    return removed;
+}
+
+/**
+ * @brief Compiles a needle into an FTS5 query matching all of its words as prefixes.
+ *
+ * Every word becomes a quoted prefix phrase, so FTS5 syntax in the needle is matched literally
+ * and "contin lear" already finds "continual learning" while it is being typed.
+ */
+QString compileQuery(const QString& needle)
+{
+    QStringList phrases;
+    for (QString word : needle.split(QLatin1Char(' '), Qt::SkipEmptyParts))
+    {
+        word.replace(QStringLiteral("\""), QStringLiteral("\"\""));
+        phrases.append(QLatin1Char('"') + word + QStringLiteral("\"*"));
+    }
+    return phrases.join(QLatin1Char(' '));
+}
+
+SearchResults Index::search(QString&& needle, const std::function<bool()>& isCancelled) const
+{
+    Trace::Span span("Index::search", "search");
+    span.arg("length", needle.size());
+    const Stats::Timer timer(Stats::Phase::Search);
+    Stats::add(Stats::Counter::Searches);
+    const auto cancelled = [&isCancelled]() { return isCancelled && isCancelled(); };
+    needle = needle.simplified();
+    if (needle.isEmpty())
+    {
+        return {};
+    }
+
+    SearchResults result{.store = itemStore(), .hits = {}};
+    if (!result.store)
+    {
+        return {};
+    }
+    const auto hydrate = [&result](const SearchCache::Hits& hits)
+    {
+        const Stats::Timer timer(Stats::Phase::Hydrate);
+        for (const auto& [rowid, score] : hits)
+        {
+            if (const auto item = result.store->find(rowid))
             {
-                const std::string data = dataQuery.value(QStringLiteral("obj")).toString().toStdString();
-                const ZoteroItem item = json::parse(data).get<ZoteroItem>();
-                result.emplace_back(item, score);
+                result.hits.emplace_back(*item, score);
             }
             else
             {
-                qCDebug(KRunnerZoteroIndex) << "Failed to get data for item " << key << ": no data";
+                qCDebug(KRunnerZoteroIndex) << "Item" << rowid << "is not in the item store";
             }
         }
+    };
+    if (const auto cached = m_searchCache.lookup(needle, result.store))
+    {
+        Stats::add(Stats::Counter::CacheHits);
+        hydrate(cached.value());
+        return result;
     }
 
-    QSqlDatabase::removeDatabase(connectionId);
+    // aborts the queries below as soon as the needle is stale
+    const ConnectionPool::CancellationScope cancellation(isCancelled);
+    // an update invalidating the pool cannot close the connection while the search uses it
+    const auto lease = m_readPool.lease();
+    SearchCache::Hits hits;
+    if (!m_searchCache.withoutExactMatches(needle, result.store))
+    {
+        const Stats::Timer queryTimer(Stats::Phase::Query);
+        QSqlQuery* query = lease.statement(IndexSQL::search);
+        if (query == nullptr)
+        {
+            return {};
+        }
+
+        query->bindValue(0, compileQuery(needle));
+        if (!query->exec())
+        {
+            query->finish();
+            if (cancelled())
+            {
+                qCDebug(KRunnerZoteroIndex) << "Search for" << needle << "cancelled";
+                Stats::add(Stats::Counter::SearchesCancelled);
+                return {};
+            }
+            qCCritical(KRunnerZoteroIndex) << "Failed to search Index: " << query->lastError().text();
+            qCCritical(KRunnerZoteroIndex) << "with query" << query->lastQuery();
+            return {};
+        }
+
+        while (query->next())
+        {
+            hits.emplace_back(query->value(0).toInt(), query->value(1).toFloat());
+        }
+        // release the read lock, the statements are reused by the next search on this thread
+        query->finish();
+    }
+    const bool exactMatches = !hits.empty();
+    if (hits.size() < SEARCH_LIMIT && !cancelled())
+    {
+        const Stats::Timer fuzzyTimer(Stats::Phase::Fuzzy);
+        Stats::add(Stats::Counter::FuzzyFallbacks);
+        fuzzySearch(lease, needle, hits, isCancelled);
+    }
+    // partial results must neither be shown nor cached
+    if (cancelled())
+    {
+        qCDebug(KRunnerZoteroIndex) << "Search for" << needle << "cancelled";
+        Stats::add(Stats::Counter::SearchesCancelled);
+        return {};
+    }
+
+    hydrate(hits);
+    m_searchCache.insert(needle, result.store, std::move(hits), exactMatches);
+
     return result;
 }
+
+void Index::fuzzySearch(const ConnectionPool::Lease& lease, const QString& needle, SearchCache::Hits& hits,
+                        const std::function<bool()>& isCancelled) const
+{
+    const QStringList words = needle.toCaseFolded().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    const QStringList trigrams = FuzzySearch::trigrams(words);
+    if (trigrams.isEmpty())
+    {
+        return;
+    }
+
+    json trigramList = json::array();
+    for (const auto& trigram : trigrams)
+    {
+        trigramList.push_back(trigram.toStdString());
+    }
+    // each statement is fetched right before it runs and finished before the next one is fetched
+    QSqlQuery* frequencyQuery = lease.statement(IndexSQL::fuzzyTrigramFrequencies);
+    if (frequencyQuery == nullptr)
+    {
+        return;
+    }
+    frequencyQuery->bindValue(0, QString::fromStdString(trigramList.dump()));
+    if (!frequencyQuery->exec())
+    {
+        // an interrupted statement fails as well
+        if (!isCancelled || !isCancelled())
+            qCCritical(KRunnerZoteroIndex) << "Failed to look up trigrams: " << frequencyQuery->lastError().text();
+        frequencyQuery->finish();
+        return;
+    }
+    std::vector<std::pair<qint64, QString>> frequencies;
+    while (frequencyQuery->next())
+    {
+        frequencies.emplace_back(frequencyQuery->value(1).toLongLong(), frequencyQuery->value(0).toString());
+    }
+    frequencyQuery->finish();
+
+    // common trigrams say little about a candidate but have the longest postings, so only the rarest
+    // ones are read; trigrams which occur nowhere (e.g. the ones containing a typo) are skipped anyway
+    std::ranges::sort(frequencies);
+    QStringList phrases;
+    qint64 postings = 0;
+    for (const auto& [frequency, trigram] : frequencies)
+    {
+        if (!phrases.isEmpty() && postings + frequency > FUZZY_POSTINGS_BUDGET)
+            break;
+        postings += frequency;
+        phrases.append(QLatin1Char('"') + QString(trigram).replace(QStringLiteral("\""), QStringLiteral("\"\"")) + QLatin1Char('"'));
+    }
+    if (phrases.isEmpty() || (isCancelled && isCancelled()))
+    {
+        return;
+    }
+
+    QSqlQuery* candidateQuery = lease.statement(IndexSQL::fuzzyCandidates);
+    if (candidateQuery == nullptr)
+    {
+        return;
+    }
+    candidateQuery->bindValue(0, phrases.join(QStringLiteral(" OR ")));
+    if (!candidateQuery->exec())
+    {
+        if (!isCancelled || !isCancelled())
+            qCCritical(KRunnerZoteroIndex) << "Failed to find fuzzy candidates: " << candidateQuery->lastError().text();
+        candidateQuery->finish();
+        return;
+    }
+    std::vector<std::pair<double, int>> ranked;
+    while (candidateQuery->next())
+    {
+        const int rowid = candidateQuery->value(0).toInt();
+        if (std::ranges::find(hits, rowid, &SearchCache::Hits::value_type::first) != hits.end())
+            continue;
+        const QString text = candidateQuery->value(1).toString() + QLatin1Char(' ') + candidateQuery->value(2).toString()
+            + QLatin1Char(' ') + candidateQuery->value(3).toString();
+        if (const double similarity = FuzzySearch::similarity(words, text); similarity > 0.0)
+        {
+            ranked.emplace_back(similarity, rowid);
+        }
+    }
+    candidateQuery->finish();
+
+    // fuzzy hits rank below all exact ones; bm25 scores are negative, the best being the lowest
+    const float base = hits.empty() ? -1.0f : hits.back().second * 0.5f;
+    std::ranges::stable_sort(ranked, std::ranges::greater{}, &std::pair<double, int>::first);
+    for (const auto& [similarity, rowid] : ranked)
+    {
+        if (hits.size() >= SEARCH_LIMIT)
+            break;
+        hits.emplace_back(rowid, base * static_cast<float>(similarity));
+    }
+}
@@ -1,28 +1,139 @@
 #pragma once
 #include <zotero.h>
 
+#include "bounded_queue.h"
+#include "connection_pool.h"
+#include "item_store.h"
+#include "search_cache.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
 #include <utility>
 
 Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroIndex)
 
 
+struct SearchResults
+{
+    // keeps the mapped item store alive while the hits are in use
+    std::shared_ptr<const ItemStore> store;
+    std::vector<std::pair<ItemView, float>> hits;
+};
+
+
 class Index
 {
 public:
     Index(QString dbIndexPath, const Zotero& zotero): m_dbIndexPath(std::move(dbIndexPath)),
-                                                      m_zotero(zotero)
+                                                      m_itemStorePath(m_dbIndexPath + QStringLiteral(".items")),
+                                                      m_shadowPath(m_dbIndexPath + QStringLiteral(".shadow")),
+                                                      m_zotero(zotero),
+                                                      m_readPool(m_dbIndexPath)
     {
     }
 
     ~Index() = default;
-    [[nodiscard]] std::vector<std::pair<ZoteroItem, float>> search(QString&& needle) const;
+    /**
+     * @brief Searches the index as the user types.
+     *
+     * All words of the needle must match, each as the prefix of a word in the index.
+     *
+     * @param isCancelled polled between the phases of the search and while SQLite runs a query;
+     *                    once it returns true, the search is aborted and returns no hits
+     */
+    [[nodiscard]] SearchResults search(QString&& needle, const std::function<bool()>& isCancelled = {}) const;
+    /// Forgets the results of the current query session, e.g. when KRunner is closed
+    void clearSearchCache() const { m_searchCache.clear(); }
     bool setup() const;
     void update(bool force = false) const;
 
 private:
+    /// Rows handed from the fetching to the decoding stage of update(), numbered in the order of their IDs
+    struct RowChunk
+    {
+        std::size_t sequence = 0;
+        std::vector<ZoteroRow> rows;
+    };
+    /// The items decoded from a RowChunk
+    struct ItemChunk
+    {
+        std::size_t sequence = 0;
+        // the highest item ID of the chunk's rows, including those that failed to decode
+        int lastId = 0;
+        ZoteroItemBatch items;
+    };
+    using ItemQueue = BoundedQueue<ItemChunk>;
+    /// What the writer of update() writes to, which decides how each batch is committed
+    enum class WriteTarget
+    {
+        // changed items, into the complete index
+        Incremental,
+        // all items, into an index that was never complete and serves them as they come
+        InPlaceBuild,
+        // all items, into the shadow that replaces the index once complete
+        ShadowBuild,
+    };
+
+    /// How far an index database was built, as recorded in its dbinfo table
+    struct BuildState
+    {
+        int version = 0;
+        // the Zotero change mark the index is up to date with, or the one its full build started from
+        std::optional<ZoteroChangeMark> mark;
+        bool complete = false;
+        // every item up to this ID was committed by an interrupted full build
+        std::optional<int> checkpoint;
+    };
+
     const QString m_dbIndexPath;
+    const QString m_itemStorePath;
+    // full rebuilds are written here and copied over the index once complete
+    const QString m_shadowPath;
     const Zotero m_zotero;
+    // long-lived read-only connections used by search(), one per calling thread
+    mutable ConnectionPool m_readPool;
+    // the currently mapped item store, replaced after every update
+    mutable std::atomic<std::shared_ptr<const ItemStore>> m_itemStore;
+    mutable SearchCache m_searchCache;
+    // set by setup() if the SQLite engine of Qt's driver is too old for the index, which is then never updated
+    mutable std::atomic<bool> m_unsupported = false;
 
-    [[nodiscard]] bool needs_update() const;
-    [[nodiscard]] QDateTime last_modified() const;
+    [[nodiscard]] BuildState buildState(const QString& path) const;
+    /// Stores @p mark, and whether the index is @p complete with it, which also clears the checkpoint
+    bool storeChangeMark(QSqlDatabase& db, const ZoteroChangeMark& mark, bool complete) const;
+    [[nodiscard]] std::shared_ptr<const ItemStore> itemStore() const;
+    int removeDeleted(QSqlDatabase& db, const std::vector<int>& validIds) const;
+    /// Merges the FTS segments added by an update, all of them into one after a @p full build
+    void optimize(QSqlDatabase& db, bool full) const;
+    /**
+     * @brief Brings the index in @p db from @p version to DB_VERSION by applying the migrations in between.
+     *
+     * @return false if there is no migration path or a step failed, and the index has to be rebuilt
+     */
+    bool migrate(QSqlDatabase& db, int version) const;
+    /// Replaces the tables at @p path with empty ones for a full build from @p mark
+    bool createTables(const QString& path, const ZoteroChangeMark& mark) const;
+    /// Replaces the content of the index with the shadow index in one transaction and removes the shadow
+    bool replaceWithShadow() const;
+    void removeShadow() const;
+    /**
+     * @brief Writer stage of update(): inserts all items from @p items until the queue is closed.
+     *
+     * Runs on its own thread with its own connection to the index at @p path. Closes @p items when
+     * done, so the decoders are never blocked by a writer that gave up. Items are added to
+     * @p storeWriter once their batch is committed, and a full build writes it to @p storePath
+     * along with every checkpoint.
+     *
+     * @return the number of inserted items, std::nullopt if the index could not be written or a
+     *         batch failed to commit
+     */
+    std::optional<int> writeItems(ItemQueue& items, const QString& path, WriteTarget target, ItemStoreWriter& storeWriter,
+                                  const QString& storePath) const;
+    std::optional<int> writeItems(QSqlDatabase& db, ItemQueue& items, WriteTarget target, ItemStoreWriter& storeWriter,
+                                  const QString& storePath) const;
+    /// Appends typo-tolerant matches of @p needle to @p hits, which are not in @p hits yet, querying through @p lease
+    void fuzzySearch(const ConnectionPool::Lease& lease, const QString& needle, SearchCache::Hits& hits,
+                     const std::function<bool()>& isCancelled) const;
 };
@@ -0,0 +1,83 @@
+#include "indexer.h"
+
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QThread>
+#include <QTimer>
+
+Q_LOGGING_CATEGORY(KRunnerZoteroIndexer, "krunner-zotero/indexer")
+
+
+Indexer::Indexer(QString zoteroPath, std::shared_ptr<const Index> index) : m_zoteroPath(std::move(zoteroPath)),
+                                                                           m_index(std::move(index))
+{
+}
+
+void Indexer::start()
+{
+    m_debounce = new QTimer(this);
+    m_debounce->setSingleShot(true);
+    m_debounce->setInterval(DEBOUNCE_MS);
+    connect(m_debounce, &QTimer::timeout, this, &Indexer::runUpdate);
+
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &Indexer::requestUpdate);
+    // the journal and WAL come and go, and a replaced file drops out of the watch list
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, [this]()
+    {
+        watch();
+        requestUpdate();
+    });
+    watch();
+
+    // setup() already rebuilds the index if it had to be (re-)created
+    if (!m_index->setup())
+        m_index->update();
+}
+
+void Indexer::requestUpdate()
+{
+    if (!m_debounce->isActive())
+    {
+        m_pendingSince.start();
+    }
+    // keep postponing while Zotero is busy writing, but not forever
+    if (m_pendingSince.elapsed() < MAX_DELAY_MS)
+    {
+        m_debounce->start();
+    }
+}
+
+void Indexer::watch()
+{
+    const QFileInfo database(m_zoteroPath);
+    QStringList paths{database.absolutePath()};
+    for (const auto& suffix : {QStringLiteral(""), QStringLiteral("-journal"), QStringLiteral("-wal")})
+    {
+        if (const QString path = database.absoluteFilePath() + suffix; QFileInfo::exists(path))
+        {
+            paths.append(path);
+        }
+    }
+
+    const QStringList watched = m_watcher->files() + m_watcher->directories();
+    QStringList missing;
+    for (const auto& path : paths)
+    {
+        if (!watched.contains(path))
+            missing.append(path);
+    }
+    if (!missing.isEmpty())
+    {
+        qCDebug(KRunnerZoteroIndexer) << "Watching" << missing;
+        m_watcher->addPaths(missing);
+    }
+}
+
+void Indexer::runUpdate()
+{
+    if (QThread::currentThread()->isInterruptionRequested())
+        return;
+    qCDebug(KRunnerZoteroIndexer) << "Zotero database changed, updating index";
+    m_index->update();
+}
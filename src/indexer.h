@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QString>
+#include <memory>
+
+#include "index.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroIndexer)
+
+
+/**
+ * @brief Keeps the index up to date from a dedicated, idle-priority thread.
+ *
+ * The indexer watches the Zotero database (and its journal/WAL) and updates the index once Zotero
+ * has stopped writing for a moment. Bursts of writes are coalesced into one update, but an update
+ * is never postponed for longer than MAX_DELAY_MS. Searches keep using the current index and item
+ * store until an update has been committed.
+ *
+ * The object must be moved to its thread before start() is invoked there.
+ */
+class Indexer final : public QObject
+{
+    Q_OBJECT
+
+public:
+    Indexer(QString zoteroPath, std::shared_ptr<const Index> index);
+
+public Q_SLOTS:
+    /// Sets up the index and starts watching Zotero, must run in the indexer thread
+    void start();
+    /// Schedules an update, bursts of requests are coalesced
+    void requestUpdate();
+
+private:
+    static constexpr int DEBOUNCE_MS = 2000;
+    static constexpr int MAX_DELAY_MS = 30000;
+
+    const QString m_zoteroPath;
+    const std::shared_ptr<const Index> m_index;
+    QFileSystemWatcher* m_watcher = nullptr;
+    QTimer* m_debounce = nullptr;
+    QElapsedTimer m_pendingSince;
+
+    void watch();
+    void runUpdate();
+};
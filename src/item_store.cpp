@@ -0,0 +1,240 @@
+#include "item_store.h"
+
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+Q_LOGGING_CATEGORY(KRunnerZoteroItemStore, "krunner-zotero/item-store")
+
+using namespace ItemStoreFormat;
+
+
+std::string_view AttachmentView::key() const { return m_store->string(m_record->key); }
+
+std::string_view AttachmentView::contentType() const { return m_store->string(m_record->contentType); }
+
+std::string_view AttachmentView::title() const { return m_store->string(m_record->title); }
+
+std::string_view ItemView::key() const { return m_store->string(m_record->key); }
+
+std::string_view ItemView::title() const { return m_store->string(m_record->title); }
+
+std::string_view ItemView::authorSummary() const { return m_store->string(m_record->authorSummary); }
+
+std::string_view ItemView::pdfKey() const { return m_store->string(m_record->pdfKey); }
+
+std::string_view ItemView::author(const std::size_t i) const { return m_store->string(m_store->m_authors[m_record->authorsBegin + i]); }
+
+AttachmentView ItemView::attachment(const std::size_t i) const { return {m_store, m_store->m_attachments + m_record->attachmentsBegin + i}; }
+
+std::shared_ptr<const ItemStore> ItemStore::open(const QString& path)
+{
+    std::shared_ptr<ItemStore> store(new ItemStore(path));
+    if (!store->map())
+    {
+        return nullptr;
+    }
+    qCDebug(KRunnerZoteroItemStore) << "Mapped item store" << path << "with" << store->size() << "item(s)";
+    return store;
+}
+
+bool ItemStore::map()
+{
+    if (!m_file.exists())
+    {
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        qCWarning(KRunnerZoteroItemStore) << "Failed to open item store: " << m_file.errorString();
+        return false;
+    }
+    const auto fileSize = static_cast<std::uint64_t>(m_file.size());
+    if (fileSize < sizeof(Header))
+    {
+        qCWarning(KRunnerZoteroItemStore) << "Item store is truncated";
+        return false;
+    }
+    const uchar* data = m_file.map(0, m_file.size());
+    if (data == nullptr)
+    {
+        qCWarning(KRunnerZoteroItemStore) << "Failed to map item store: " << m_file.errorString();
+        return false;
+    }
+
+    m_header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(m_header->magic, MAGIC, sizeof(MAGIC)) != 0 || m_header->version != VERSION)
+    {
+        qCInfo(KRunnerZoteroItemStore) << "Item store has an unknown format or outdated version";
+        return false;
+    }
+
+    const std::uint64_t itemsSize = std::uint64_t{m_header->itemCount} * sizeof(ItemRecord);
+    const std::uint64_t authorsSize = std::uint64_t{m_header->authorCount} * sizeof(StringRef);
+    const std::uint64_t attachmentsSize = std::uint64_t{m_header->attachmentCount} * sizeof(AttachmentRecord);
+    if (sizeof(Header) + itemsSize + authorsSize + attachmentsSize + m_header->arenaSize != fileSize)
+    {
+        qCWarning(KRunnerZoteroItemStore) << "Item store size does not match its header";
+        return false;
+    }
+    m_items = reinterpret_cast<const ItemRecord*>(data + sizeof(Header));
+    m_authors = reinterpret_cast<const StringRef*>(data + sizeof(Header) + itemsSize);
+    m_attachments = reinterpret_cast<const AttachmentRecord*>(data + sizeof(Header) + itemsSize + authorsSize);
+    m_arena = reinterpret_cast<const char*>(data + sizeof(Header) + itemsSize + authorsSize + attachmentsSize);
+
+    // validate all references once, so views never have to
+    const auto inArena = [this](const StringRef& ref) { return std::uint64_t{ref.offset} + ref.size <= m_header->arenaSize; };
+    for (std::uint32_t i = 0; i < m_header->authorCount; ++i)
+    {
+        if (!inArena(m_authors[i]))
+            return false;
+    }
+    for (std::uint32_t i = 0; i < m_header->attachmentCount; ++i)
+    {
+        if (const auto& a = m_attachments[i]; !inArena(a.key) || !inArena(a.contentType) || !inArena(a.title))
+            return false;
+    }
+    for (std::uint32_t i = 0; i < m_header->itemCount; ++i)
+    {
+        const auto& item = m_items[i];
+        if (!inArena(item.key) || !inArena(item.title) || !inArena(item.authorSummary) || !inArena(item.pdfKey)
+            || std::uint64_t{item.authorsBegin} + item.authorsCount > m_header->authorCount
+            || std::uint64_t{item.attachmentsBegin} + item.attachmentsCount > m_header->attachmentCount
+            || (i > 0 && m_items[i - 1].rowid >= item.rowid))
+        {
+            qCWarning(KRunnerZoteroItemStore) << "Item store is corrupt at item" << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<ItemView> ItemStore::find(const int rowid) const
+{
+    const auto* end = m_items + m_header->itemCount;
+    const auto* it = std::lower_bound(m_items, end, rowid, [](const ItemRecord& record, const int id) { return record.rowid < id; });
+    if (it == end || it->rowid != rowid)
+    {
+        return std::nullopt;
+    }
+    return ItemView(this, it);
+}
+
+
+void ItemStoreWriter::add(const ZoteroItem& item)
+{
+    if (!m_rowids.insert(item.id).second)
+    {
+        return;
+    }
+    ItemRecord record{.rowid = item.id,
+                      .key = append(item.key),
+                      .title = append(item.displayTitle()),
+                      .authorSummary = append(item.authorSummary().toStdString()),
+                      .pdfKey = append(item.pdfKey()),
+                      .year = item.year().toInt(),
+                      .authorsBegin = static_cast<std::uint32_t>(m_authors.size()),
+                      .authorsCount = static_cast<std::uint32_t>(item.authors.size()),
+                      .attachmentsBegin = static_cast<std::uint32_t>(m_attachments.size()),
+                      .attachmentsCount = static_cast<std::uint32_t>(item.attachments.size())};
+    for (const auto& author : item.authors)
+    {
+        m_authors.push_back(intern(author));
+    }
+    for (const auto& attachment : item.attachments)
+    {
+        m_attachments.push_back({.key = append(attachment.key),
+                                 .contentType = intern(attachment.contentType),
+                                 .title = intern(attachment.title)});
+    }
+    m_items.push_back(record);
+}
+
+void ItemStoreWriter::add(const ItemView& item)
+{
+    if (!m_rowids.insert(item.rowid()).second)
+    {
+        return;
+    }
+    ItemRecord record{.rowid = item.rowid(),
+                      .key = append(item.key()),
+                      .title = append(item.title()),
+                      .authorSummary = append(item.authorSummary()),
+                      .pdfKey = append(item.pdfKey()),
+                      .year = item.year(),
+                      .authorsBegin = static_cast<std::uint32_t>(m_authors.size()),
+                      .authorsCount = static_cast<std::uint32_t>(item.authorCount()),
+                      .attachmentsBegin = static_cast<std::uint32_t>(m_attachments.size()),
+                      .attachmentsCount = static_cast<std::uint32_t>(item.attachmentCount())};
+    for (std::size_t i = 0; i < item.authorCount(); ++i)
+    {
+        m_authors.push_back(intern(item.author(i)));
+    }
+    for (std::size_t i = 0; i < item.attachmentCount(); ++i)
+    {
+        const auto attachment = item.attachment(i);
+        m_attachments.push_back({.key = append(attachment.key()),
+                                 .contentType = intern(attachment.contentType()),
+                                 .title = intern(attachment.title())});
+    }
+    m_items.push_back(record);
+}
+
+bool ItemStoreWriter::write(const QString& path)
+{
+    if (m_arena.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        qCCritical(KRunnerZoteroItemStore) << "Item store exceeds 4 GiB, not written";
+        return false;
+    }
+    std::ranges::sort(m_items, {}, &ItemRecord::rowid);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.itemCount = static_cast<std::uint32_t>(m_items.size());
+    header.authorCount = static_cast<std::uint32_t>(m_authors.size());
+    header.attachmentCount = static_cast<std::uint32_t>(m_attachments.size());
+    header.arenaSize = static_cast<std::uint32_t>(m_arena.size());
+
+    // QSaveFile writes to a temporary file and renames it over the old store on commit
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qCCritical(KRunnerZoteroItemStore) << "Failed to open item store for writing: " << file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_items.data()), static_cast<qint64>(m_items.size() * sizeof(ItemRecord)));
+    file.write(reinterpret_cast<const char*>(m_authors.data()), static_cast<qint64>(m_authors.size() * sizeof(StringRef)));
+    file.write(reinterpret_cast<const char*>(m_attachments.data()), static_cast<qint64>(m_attachments.size() * sizeof(AttachmentRecord)));
+    file.write(m_arena.data(), static_cast<qint64>(m_arena.size()));
+    if (!file.commit())
+    {
+        qCCritical(KRunnerZoteroItemStore) << "Failed to write item store: " << file.errorString();
+        return false;
+    }
+    qCDebug(KRunnerZoteroItemStore) << "Wrote item store with" << m_items.size() << "item(s)," << m_arena.size() << "bytes of strings";
+    return true;
+}
+
+StringRef ItemStoreWriter::append(const std::string_view str)
+{
+    const StringRef ref{.offset = static_cast<std::uint32_t>(m_arena.size()), .size = static_cast<std::uint32_t>(str.size())};
+    m_arena.append(str);
+    return ref;
+}
+
+StringRef ItemStoreWriter::intern(const std::string_view str)
+{
+    if (str.empty())
+    {
+        return {};
+    }
+    if (const auto it = m_interned.find(str); it != m_interned.end())
+    {
+        return it->second;
+    }
+    return m_interned.emplace(str, append(str)).first->second;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QString>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "zotero_item.h"
+
+Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroItemStore)
+
+
+/**
+ * On-disk layout of the item store, all integers in native byte order:
+ *
+ *   Header
+ *   ItemRecord[itemCount]              sorted by rowid
+ *   StringRef[authorCount]             author names, referenced by ItemRecord::authors*
+ *   AttachmentRecord[attachmentCount]  referenced by ItemRecord::attachments*
+ *   char[arenaSize]                    string arena, referenced by StringRef
+ *
+ * Every section consists of 4-byte fields only, so all records are naturally aligned.
+ */
+namespace ItemStoreFormat
+{
+constexpr char MAGIC[8] = {'K', 'R', 'Z', 'I', 'T', 'E', 'M', 'S'};
+constexpr std::uint32_t VERSION = 2;
+
+struct StringRef
+{
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t itemCount;
+    std::uint32_t authorCount;
+    std::uint32_t attachmentCount;
+    std::uint32_t arenaSize;
+    std::uint32_t reserved;
+};
+
+// title, authorSummary, year and pdfKey are computed at index time, so displaying a result needs no parsing
+struct ItemRecord
+{
+    std::int32_t rowid;
+    StringRef key;
+    StringRef title;
+    StringRef authorSummary;
+    StringRef pdfKey;
+    std::int32_t year; // 0 if unknown
+    std::uint32_t authorsBegin;
+    std::uint32_t authorsCount;
+    std::uint32_t attachmentsBegin;
+    std::uint32_t attachmentsCount;
+};
+
+struct AttachmentRecord
+{
+    StringRef key;
+    StringRef contentType;
+    StringRef title;
+};
+
+static_assert(sizeof(Header) == 32);
+static_assert(sizeof(ItemRecord) == 56);
+static_assert(sizeof(AttachmentRecord) == 24);
+} // namespace ItemStoreFormat
+
+
+class ItemStore;
+
+/// Zero-copy view of one attachment in an ItemStore
+class AttachmentView
+{
+public:
+    AttachmentView(const ItemStore* store, const ItemStoreFormat::AttachmentRecord* record) : m_store(store), m_record(record) {}
+
+    [[nodiscard]] std::string_view key() const;
+    [[nodiscard]] std::string_view contentType() const;
+    [[nodiscard]] std::string_view title() const;
+
+private:
+    const ItemStore* m_store;
+    const ItemStoreFormat::AttachmentRecord* m_record;
+};
+
+/// Zero-copy view of one item in an ItemStore, only valid as long as the store is alive
+class ItemView
+{
+public:
+    ItemView(const ItemStore* store, const ItemStoreFormat::ItemRecord* record) : m_store(store), m_record(record) {}
+
+    [[nodiscard]] int rowid() const { return m_record->rowid; }
+    [[nodiscard]] std::string_view key() const;
+    [[nodiscard]] std::string_view title() const;
+    [[nodiscard]] std::string_view authorSummary() const;
+    /// Key of the first PDF attachment, empty if there is none
+    [[nodiscard]] std::string_view pdfKey() const;
+    [[nodiscard]] int year() const { return m_record->year; }
+    [[nodiscard]] std::size_t authorCount() const { return m_record->authorsCount; }
+    [[nodiscard]] std::string_view author(std::size_t i) const;
+    [[nodiscard]] std::size_t attachmentCount() const { return m_record->attachmentsCount; }
+    [[nodiscard]] AttachmentView attachment(std::size_t i) const;
+
+
+private:
+    const ItemStore* m_store;
+    const ItemStoreFormat::ItemRecord* m_record;
+};
+
+
+/**
+ * @brief Read-only, memory-mapped store of the item fields shown in search results.
+ *
+ * The file is written once per index update by ItemStoreWriter and replaced atomically, so a
+ * mapped store never changes underneath its readers. Readers share the store through a
+ * std::shared_ptr, which keeps the mapping alive while views into it are in use.
+ */
+class ItemStore
+{
+public:
+    /// @return nullptr if the file does not exist, is not a valid store or has an outdated version
+    [[nodiscard]] static std::shared_ptr<const ItemStore> open(const QString& path);
+
+    ItemStore(const ItemStore&) = delete;
+    ItemStore& operator=(const ItemStore&) = delete;
+
+    [[nodiscard]] std::size_t size() const { return m_header->itemCount; }
+    [[nodiscard]] ItemView at(std::size_t i) const { return {this, m_items + i}; }
+    /// Looks up an item by its rowid (i.e. Zotero item ID) with a binary search
+    [[nodiscard]] std::optional<ItemView> find(int rowid) const;
+
+private:
+    friend class ItemView;
+    friend class AttachmentView;
+
+    explicit ItemStore(const QString& path) : m_file(path) {}
+    bool map();
+
+    [[nodiscard]] std::string_view string(const ItemStoreFormat::StringRef& ref) const { return {m_arena + ref.offset, ref.size}; }
+
+    QFile m_file;
+    const ItemStoreFormat::Header* m_header = nullptr;
+    const ItemStoreFormat::ItemRecord* m_items = nullptr;
+    const ItemStoreFormat::StringRef* m_authors = nullptr;
+    const ItemStoreFormat::AttachmentRecord* m_attachments = nullptr;
+    const char* m_arena = nullptr;
+};
+
+
+/**
+ * @brief Builds a new item store file.
+ *
+ * Items are added either freshly extracted from Zotero or copied over from the previous store;
+ * an item that was already added is not added a second time. Strings are interned in the arena.
+ */
+class ItemStoreWriter
+{
+    struct StringHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(const std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+
+public:
+    void add(const ZoteroItem& item);
+    void add(const ItemView& item);
+    [[nodiscard]] bool contains(const int rowid) const { return m_rowids.contains(rowid); }
+    [[nodiscard]] std::size_t size() const { return m_items.size(); }
+
+    /// Atomically replaces the file at @p path with the added items
+    [[nodiscard]] bool write(const QString& path);
+
+private:
+    std::vector<ItemStoreFormat::ItemRecord> m_items;
+    std::vector<ItemStoreFormat::StringRef> m_authors;
+    std::vector<ItemStoreFormat::AttachmentRecord> m_attachments;
+    std::string m_arena;
+    std::unordered_map<std::string, ItemStoreFormat::StringRef, StringHash, std::equal_to<>> m_interned;
+    std::unordered_set<int> m_rowids;
+
+    ItemStoreFormat::StringRef append(std::string_view str);
+    /// Like append(), but stores repeated strings (author names, content types, ...) only once
+    ItemStoreFormat::StringRef intern(std::string_view str);
+};
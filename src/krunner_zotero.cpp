@@ -5,66 +5,100 @@
 #include <QDir>
 #include <QStandardPaths>
 #include <QString>
+#include <QStringList>
 #include <index.h>
+#include <stats.h>
+#include <trace.h>
 
 Q_LOGGING_CATEGORY(KRunnerZotero, "krunner-zotero")
 
 
+ZoteroRunner::~ZoteroRunner()
+{
+    stopIndexer();
+    Trace::stop();
+}
+
 void ZoteroRunner::init()
 {
+    // e.g. KRUNNER_ZOTERO_TRACE=/tmp/krunner-zotero.json, see trace.h
+    if (const QString tracePath = qEnvironmentVariable("KRUNNER_ZOTERO_TRACE"); !tracePath.isEmpty())
+        Trace::start(tracePath);
     reloadConfiguration();
     this->setMinLetterCount(3);
-    const Zotero zotero(m_zoteroPath);
-    const Index index(m_dbPath, zotero);
-    // ReSharper disable once CppExpressionWithoutSideEffects
-    index.setup();
 
-    connect(this, &AbstractRunner::prepare, this,
-            [this]() { Index(m_dbPath, Zotero(m_zoteroPath)).update(); });
+    // the watcher normally notices changes first, this only catches the ones it missed
+    connect(this, &AbstractRunner::prepare, this, [this]()
+    {
+        if (m_indexer)
+            QMetaObject::invokeMethod(m_indexer, &Indexer::requestUpdate, Qt::QueuedConnection);
+    });
+    connect(this, &AbstractRunner::teardown, this, [this]()
+    {
+        if (const auto index = m_index.load())
+            index->clearSearchCache();
+        // enable with QT_LOGGING_RULES="krunner-zotero/stats.debug=true", or write them to a file with
+        // KRUNNER_ZOTERO_STATS=/tmp/krunner-zotero-stats.txt
+        qCDebug(KRunnerZoteroStats).noquote() << "Performance stats:\n" << Stats::report();
+        if (!m_statsPath.isEmpty())
+            Stats::writeReport(m_statsPath);
+        // KRunner lives on, so the trace of a session has to be readable while it does
+        Trace::flush();
+    });
 }
 
 void ZoteroRunner::match(KRunner::RunnerContext &context)
 {
+    const Trace::Span span("ZoteroRunner::match", "search");
+    const auto index = m_index.load();
+    if (!index)
+        return;
+
+    // KRunner invalidates the context as soon as the query changes, nobody will see its results then
+    const auto results = index->search(context.query(), [&context]() { return !context.isValid(); });
+    if (!context.isValid())
+        return;
+
+    const Stats::Timer timer(Stats::Phase::Matches);
     QList<KRunner::QueryMatch> matches;
-    const Zotero zotero(m_zoteroPath);
-    const Index index(m_dbPath, zotero);
-    const auto results = index.search(context.query());
-    for (const auto &[item, score] : results)
+    for (const auto &[item, score] : results.hits)
     {
         KRunner::QueryMatch match(this);
-        if (item.year().isEmpty()) {
-            match.setText(QStringLiteral("<b>%1</b><br><i>%2</i>").arg(QString::fromStdString(item.meta.at("title")), item.authorSummary()));
+        // all display fields are precomputed by the indexer
+        const auto title = QString::fromUtf8(item.title());
+        const auto authors = QString::fromUtf8(item.authorSummary());
+        if (item.year() == 0) {
+            match.setText(QStringLiteral("<b>%1</b><br><i>%2</i>").arg(title, authors));
         } else {
-            match.setText(QStringLiteral("<b>%1</b><br><i>%2 (%3)</i>").arg(QString::fromStdString(item.meta.at("title")), item.authorSummary(), item.year()));
+            match.setText(QStringLiteral("<b>%1</b><br><i>%2 (%3)</i>").arg(title, authors, QString::number(item.year())));
         }
-        match.setData(QString::fromStdString(json(item).dump()));
+        // run() only needs to know what to open, everything else stays in the item store
+        match.setData(QStringList{QString::fromUtf8(item.key()), QString::fromUtf8(item.pdfKey())});
         match.setMultiLine(true);
         match.setIconName(QStringLiteral("zotero"));
-        match.setRelevance(score / results[0].second);
+        match.setRelevance(score / results.hits[0].second);
         match.setCategoryRelevance(KRunner::QueryMatch::CategoryRelevance::High);
         matches.emplace_back(match);
     }
-    context.addMatches(matches);
+    if (context.isValid())
+        context.addMatches(matches);
 }
 
 void ZoteroRunner::run(const KRunner::RunnerContext &context, const KRunner::QueryMatch &match)
 {
     Q_UNUSED(context);
-    const ZoteroItem item = json::parse(match.data().toString().toStdString()).get<ZoteroItem>();
-    for (const auto &attachment : item.attachments)
+    const QStringList data = match.data().toStringList();
+    const QString key = data.value(0);
+    if (const QString pdfKey = data.value(1); !pdfKey.isEmpty())
     {
-        if (attachment.contentType == "application/pdf")
-        {
-            const QUrl url(QStringLiteral("zotero://open-pdf/library/items/") +
-                QString::fromStdString(attachment.key));
-            // ReSharper disable once CppDFAMemoryLeak
-            const auto job = new KIO::OpenUrlJob(url);
-            job->start();
-            return;
-        }
+        const QUrl url(QStringLiteral("zotero://open-pdf/library/items/") + pdfKey);
+        // ReSharper disable once CppDFAMemoryLeak
+        const auto job = new KIO::OpenUrlJob(url);
+        job->start();
+        return;
     }
-    qCDebug(KRunnerZotero) << "No PDF attachment found, opening Zotero item." << QString::fromStdString(item.key);
-    const QUrl url(QStringLiteral("zotero://select/library/items/") + QString::fromStdString(item.key));
+    qCDebug(KRunnerZotero) << "No PDF attachment found, opening Zotero item." << key;
+    const QUrl url(QStringLiteral("zotero://select/library/items/") + key);
     // ReSharper disable once CppDFAMemoryLeak
     const auto job = new KIO::OpenUrlJob(url);
     job->start();
@@ -79,6 +113,31 @@ void ZoteroRunner::reloadConfiguration()
         if (!KRunnerPath.mkpath(QStringLiteral(".")))
             qCDebug(KRunnerZotero) << "Failed to create KRunner directory.";
     m_dbPath = c.readEntry("dbPath", KRunnerPath.filePath(QStringLiteral("zotero.sqlite")));
+    m_statsPath = qEnvironmentVariable("KRUNNER_ZOTERO_STATS");
+    m_index.store(std::make_shared<const Index>(m_dbPath, Zotero(m_zoteroPath)));
+    startIndexer();
+}
+
+void ZoteroRunner::startIndexer()
+{
+    stopIndexer();
+    m_indexer = new Indexer(m_zoteroPath, m_index.load());
+    m_indexer->moveToThread(&m_indexerThread);
+    m_indexerThread.setObjectName(QStringLiteral("zotero-indexer"));
+    connect(&m_indexerThread, &QThread::started, m_indexer, &Indexer::start);
+    connect(&m_indexerThread, &QThread::finished, m_indexer, &QObject::deleteLater);
+    m_indexerThread.start(QThread::IdlePriority);
+}
+
+void ZoteroRunner::stopIndexer()
+{
+    if (!m_indexerThread.isRunning())
+        return;
+    // a running update stops at the next item and resumes with the next one
+    m_indexerThread.requestInterruption();
+    m_indexerThread.quit();
+    m_indexerThread.wait();
+    m_indexer = nullptr;
 }
 
 
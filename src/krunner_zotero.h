@@ -2,7 +2,12 @@
 
 #include <QLoggingCategory>
 #include <KRunner/AbstractRunner>
+#include <QThread>
 #include <index.h>
+#include <indexer.h>
+
+#include <atomic>
+#include <memory>
 
 Q_DECLARE_LOGGING_CATEGORY(KRunnerZotero)
 
@@ -13,6 +18,7 @@ class ZoteroRunner final : public KRunner::AbstractRunner
 
 public:
     ZoteroRunner(QObject* parent, const KPluginMetaData& data) : AbstractRunner(parent, data) {}
+    ~ZoteroRunner() override;
 
     void match(KRunner::RunnerContext& context) override;
     void run(const KRunner::RunnerContext& context, const KRunner::QueryMatch& match) override;
@@ -22,6 +28,16 @@ protected:
     void init() override;
 
 private:
+    void startIndexer();
+    void stopIndexer();
+
     QString m_zoteroPath;
     QString m_dbPath;
+    // performance stats are written here at the end of every query session, empty unless opted in
+    QString m_statsPath;
+    // shared with in-flight match() calls, which may outlive a configuration reload
+    std::atomic<std::shared_ptr<const Index>> m_index;
+    // index updates run here, so match() never waits for one
+    QThread m_indexerThread;
+    Indexer* m_indexer = nullptr;
 };
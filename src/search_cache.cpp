@@ -0,0 +1,41 @@
+#include "search_cache.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+
+std::optional<SearchCache::Hits> SearchCache::lookup(const QString& query, const std::shared_ptr<const ItemStore>& store) const
+{
+    const QMutexLocker locker(&m_mutex);
+    for (const auto& entry : m_entries)
+    {
+        if (entry.query == query && entry.store.lock() == store)
+            return entry.hits;
+    }
+    return std::nullopt;
+}
+
+bool SearchCache::withoutExactMatches(const QString& query, const std::shared_ptr<const ItemStore>& store) const
+{
+    const QMutexLocker locker(&m_mutex);
+    // every exact match of an extended query is also an exact match of the shorter one
+    return std::ranges::any_of(m_entries, [&](const Entry& entry)
+    {
+        return !entry.exactMatches && query.startsWith(entry.query) && entry.store.lock() == store;
+    });
+}
+
+void SearchCache::insert(const QString& query, const std::shared_ptr<const ItemStore>& store, Hits hits, const bool exactMatches)
+{
+    const QMutexLocker locker(&m_mutex);
+    std::erase_if(m_entries, [&query](const Entry& entry) { return entry.query == query; });
+    m_entries.push_front({.query = query, .store = store, .hits = std::move(hits), .exactMatches = exactMatches});
+    if (m_entries.size() > CAPACITY)
+        m_entries.pop_back();
+}
+
+void SearchCache::clear()
+{
+    const QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "item_store.h"
+
+
+/**
+ * @brief Recent search results of one KRunner session, keyed by the simplified needle.
+ *
+ * While typing, KRunner runs one query per keystroke and each query extends the previous one. A
+ * query extending one without any exact match cannot match anything exactly either, so only the
+ * fuzzy fallback has to run for it. A query seen before (e.g. after deleting a character) is
+ * answered from its cached hits. Both are exact, so cached results never differ from what the
+ * index would return.
+ *
+ * Entries are bound to the item store they were computed with. An index update replaces the
+ * store, which implicitly invalidates all entries.
+ */
+class SearchCache
+{
+public:
+    /// (rowid, score) pairs in rank order
+    using Hits = std::vector<std::pair<int, float>>;
+
+    [[nodiscard]] std::optional<Hits> lookup(const QString& query, const std::shared_ptr<const ItemStore>& store) const;
+    /// Whether @p query extends an earlier query without exact (i.e. non-fuzzy) matches
+    [[nodiscard]] bool withoutExactMatches(const QString& query, const std::shared_ptr<const ItemStore>& store) const;
+    void insert(const QString& query, const std::shared_ptr<const ItemStore>& store, Hits hits, bool exactMatches);
+    void clear();
+
+private:
+    static constexpr std::size_t CAPACITY = 32;
+
+    struct Entry
+    {
+        QString query;
+        // only compared, never dereferenced, so a replaced store is not kept alive
+        std::weak_ptr<const ItemStore> store;
+        Hits hits;
+        bool exactMatches;
+    };
+
+    mutable QMutex m_mutex;
+    std::deque<Entry> m_entries; // most recent first
+};
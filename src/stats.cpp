@@ -0,0 +1,175 @@
+#include "stats.h"
+
+#include <QSaveFile>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+
+Q_LOGGING_CATEGORY(KRunnerZoteroStats, "krunner-zotero/stats")
+
+
+namespace
+{
+// bucket 0 holds latencies below 1 µs, bucket i those below 2^i µs, the last one everything above
+constexpr std::size_t BUCKET_COUNT = 32;
+
+constexpr std::array<const char*, Stats::PHASE_COUNT> PHASE_NAMES = {
+    "snapshot", "extract", "decode", "insert", "commit", "collect", "search", "query", "fuzzy", "hydrate", "matches",
+};
+constexpr std::array<const char*, Stats::COUNTER_COUNT> COUNTER_NAMES = {
+    "items_decoded", "decode_errors", "items_inserted", "items_deleted", "searches", "cache_hits", "searches_cancelled", "fuzzy_fallbacks",
+};
+
+struct Histogram
+{
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> totalNs;
+    std::atomic<std::uint64_t> maxNs;
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets;
+};
+
+std::array<Histogram, Stats::PHASE_COUNT> g_phases{};
+std::array<std::atomic<std::int64_t>, Stats::COUNTER_COUNT> g_counters{};
+
+// consistent enough for a report, recording never waits for it
+struct Summary
+{
+    std::uint64_t count = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+    std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+
+    explicit Summary(const Histogram& histogram)
+        : count(histogram.count.load(std::memory_order_relaxed)),
+          totalMs(static_cast<double>(histogram.totalNs.load(std::memory_order_relaxed)) / 1e6),
+          maxMs(static_cast<double>(histogram.maxNs.load(std::memory_order_relaxed)) / 1e6)
+    {
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+            buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] double meanMs() const { return count == 0 ? 0.0 : totalMs / static_cast<double>(count); }
+
+    /// Upper bound of the bucket the @p p th percentile falls into, at most the maximum
+    [[nodiscard]] double percentileMs(const double p) const
+    {
+        const auto rank = static_cast<std::uint64_t>(std::ceil(p / 100.0 * static_cast<double>(count)));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0)
+                return std::min(static_cast<double>(std::uint64_t{1} << i) / 1000.0, maxMs);
+        }
+        return maxMs;
+    }
+};
+} // namespace
+
+
+void Stats::record(const Phase phase, const Clock::duration elapsed)
+{
+    const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    const std::size_t bucket = std::min<std::size_t>(BUCKET_COUNT - 1, std::bit_width(ns / 1000));
+
+    auto& histogram = g_phases[static_cast<std::size_t>(phase)];
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    auto max = histogram.maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !histogram.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Stats::add(const Counter counter, const std::int64_t n)
+{
+    g_counters[static_cast<std::size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+QString Stats::report()
+{
+    QString report = QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                         .arg(QStringLiteral("phase"), -10)
+                         .arg(QStringLiteral("count"), 10)
+                         .arg(QStringLiteral("total ms"), 12)
+                         .arg(QStringLiteral("mean ms"), 10)
+                         .arg(QStringLiteral("p50 ms"), 10)
+                         .arg(QStringLiteral("p90 ms"), 10)
+                         .arg(QStringLiteral("p99 ms"), 10)
+                         .arg(QStringLiteral("max ms"), 10);
+    for (std::size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        const Summary summary(g_phases[i]);
+        if (summary.count == 0)
+            continue;
+        report += QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                      .arg(QString::fromLatin1(PHASE_NAMES[i]), -10)
+                      .arg(summary.count, 10)
+                      .arg(summary.totalMs, 12, 'f', 1)
+                      .arg(summary.meanMs(), 10, 'f', 3)
+                      .arg(summary.percentileMs(50), 10, 'f', 3)
+                      .arg(summary.percentileMs(90), 10, 'f', 3)
+                      .arg(summary.percentileMs(99), 10, 'f', 3)
+                      .arg(summary.maxMs, 10, 'f', 3);
+    }
+    for (std::size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        report += QStringLiteral("%1 %2\n").arg(QString::fromLatin1(COUNTER_NAMES[i]), -20).arg(g_counters[i].load(std::memory_order_relaxed));
+    }
+    return report;
+}
+
+nlohmann::json Stats::toJson()
+{
+    nlohmann::json phases = nlohmann::json::object();
+    for (std::size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        const Summary summary(g_phases[i]);
+        if (summary.count == 0)
+            continue;
+        phases[PHASE_NAMES[i]] = {{"count", summary.count},
+                                  {"total_ms", summary.totalMs},
+                                  {"mean_ms", summary.meanMs()},
+                                  {"p50_ms", summary.percentileMs(50)},
+                                  {"p90_ms", summary.percentileMs(90)},
+                                  {"p99_ms", summary.percentileMs(99)},
+                                  {"max_ms", summary.maxMs}};
+    }
+    nlohmann::json counters = nlohmann::json::object();
+    for (std::size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        counters[COUNTER_NAMES[i]] = g_counters[i].load(std::memory_order_relaxed);
+    }
+    return {{"phases", std::move(phases)}, {"counters", std::move(counters)}};
+}
+
+bool Stats::writeReport(const QString& path)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qCWarning(KRunnerZoteroStats) << "Failed to write stats to" << path << ":" << file.errorString();
+        return false;
+    }
+    file.write(report().toUtf8());
+    return file.commit();
+}
+
+void Stats::reset()
+{
+    for (auto& histogram : g_phases)
+    {
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.totalNs.store(0, std::memory_order_relaxed);
+        histogram.maxNs.store(0, std::memory_order_relaxed);
+        for (auto& bucket : histogram.buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto& counter : g_counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QString>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroStats)
+
+
+/**
+ * @brief Process-wide performance counters and latency histograms.
+ *
+ * Recording is lock-free and cheap enough to time every item and every keystroke. Latencies go
+ * into power-of-two microsecond buckets, so the percentiles of a report are upper bounds accurate
+ * to a factor of two. At the end of every query session, the runner logs a report to the
+ * krunner-zotero/stats debug category and writes it to the file named by the KRUNNER_ZOTERO_STATS
+ * environment variable, if either is enabled.
+ */
+namespace Stats
+{
+using Clock = std::chrono::steady_clock;
+
+enum class Phase : std::uint8_t
+{
+    Snapshot, // opening or copying the Zotero database
+    Extract, // running the item query, per update
+    Decode, // decoding the JSON of one item
+    Insert, // inserting one item into the index
+    Commit, // committing one batch of items
+    Collect, // removing deleted items, per update
+    Search, // all of Index::search, per keystroke
+    Query, // the FTS query of a search
+    Fuzzy, // the typo-tolerant fallback of a search
+    Hydrate, // looking up the hits of a search in the item store
+    Matches, // building the KRunner matches of a search
+};
+constexpr std::size_t PHASE_COUNT = static_cast<std::size_t>(Phase::Matches) + 1;
+
+enum class Counter : std::uint8_t
+{
+    ItemsDecoded,
+    DecodeErrors,
+    ItemsInserted,
+    ItemsDeleted,
+    Searches,
+    CacheHits,
+    SearchesCancelled,
+    FuzzyFallbacks,
+};
+constexpr std::size_t COUNTER_COUNT = static_cast<std::size_t>(Counter::FuzzyFallbacks) + 1;
+
+void record(Phase phase, Clock::duration elapsed);
+void add(Counter counter, std::int64_t n = 1);
+
+/// Records the time from its construction to its destruction
+class Timer
+{
+public:
+    explicit Timer(const Phase phase) : m_phase(phase), m_start(Clock::now()) {}
+    ~Timer() { record(m_phase, Clock::now() - m_start); }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+private:
+    const Phase m_phase;
+    const Clock::time_point m_start;
+};
+
+/// Adds up the intervals between start() and stop() and records their sum as one event on destruction
+class Accumulator
+{
+public:
+    explicit Accumulator(const Phase phase) : m_phase(phase) {}
+    ~Accumulator() { record(m_phase, m_total); }
+
+    Accumulator(const Accumulator&) = delete;
+    Accumulator& operator=(const Accumulator&) = delete;
+
+    void start() { m_start = Clock::now(); }
+    void stop() { m_total += Clock::now() - m_start; }
+
+private:
+    const Phase m_phase;
+    Clock::time_point m_start;
+    Clock::duration m_total{};
+};
+
+/// Human-readable table of all phases and counters
+[[nodiscard]] QString report();
+/// All phases and counters, for the benchmark suite
+[[nodiscard]] nlohmann::json toJson();
+bool writeReport(const QString& path);
+void reset();
+} // namespace Stats
@@ -0,0 +1,140 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <nlohmann/json.hpp>
+
+Q_LOGGING_CATEGORY(KRunnerZoteroTrace, "krunner-zotero/trace")
+
+std::atomic<bool> Trace::g_enabled = false;
+
+
+namespace
+{
+// pending events are written once they exceed this many bytes, or are this old
+constexpr std::size_t FLUSH_SIZE = 64 * 1024;
+constexpr auto FLUSH_INTERVAL = std::chrono::seconds(1);
+
+QMutex g_mutex;
+QFile g_file;
+std::string g_pending;
+std::chrono::steady_clock::time_point g_origin;
+std::chrono::steady_clock::time_point g_lastFlush;
+// bumped by every start(), so threads announce their names again in a new trace
+std::uint64_t g_generation = 0;
+std::atomic<std::uint32_t> g_nextThreadId = 1;
+
+struct ThreadInfo
+{
+    std::uint32_t id = g_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t announced = 0;
+};
+thread_local ThreadInfo t_thread;
+
+void writePending()
+{
+    if (!g_pending.empty())
+    {
+        g_file.write(g_pending.data(), static_cast<qint64>(g_pending.size()));
+        g_pending.clear();
+    }
+    g_file.flush();
+    g_lastFlush = std::chrono::steady_clock::now();
+}
+
+void append(const nlohmann::json& event)
+{
+    g_pending += event.dump();
+    g_pending += ",\n";
+}
+
+QString threadName()
+{
+    if (const QThread* thread = QThread::currentThread(); thread != nullptr)
+    {
+        if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread())
+            return QStringLiteral("main");
+        if (!thread->objectName().isEmpty())
+            return thread->objectName();
+    }
+    return QStringLiteral("thread %1").arg(t_thread.id);
+}
+} // namespace
+
+
+bool Trace::start(const QString& path)
+{
+    const QMutexLocker locker(&g_mutex);
+    if (g_file.isOpen())
+    {
+        writePending();
+        g_file.close();
+    }
+    g_file.setFileName(path);
+    if (!g_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCWarning(KRunnerZoteroTrace) << "Failed to open trace file" << path << ":" << g_file.errorString();
+        g_enabled = false;
+        return false;
+    }
+    g_pending = "[\n";
+    g_origin = std::chrono::steady_clock::now();
+    g_lastFlush = g_origin;
+    ++g_generation;
+    g_enabled = true;
+    qCInfo(KRunnerZoteroTrace) << "Tracing to" << path;
+    return true;
+}
+
+void Trace::stop()
+{
+    const QMutexLocker locker(&g_mutex);
+    g_enabled = false;
+    if (!g_file.isOpen())
+        return;
+    writePending();
+    g_file.close();
+}
+
+void Trace::flush()
+{
+    const QMutexLocker locker(&g_mutex);
+    if (g_file.isOpen())
+        writePending();
+}
+
+Trace::Span::~Span()
+{
+    if (!m_active)
+        return;
+    const auto end = std::chrono::steady_clock::now();
+
+    const QMutexLocker locker(&g_mutex);
+    // tracing stopped or restarted while the span was open
+    if (!enabled() || m_start < g_origin)
+        return;
+    const auto micros = [](const std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    const auto pid = QCoreApplication::applicationPid();
+    if (t_thread.announced != g_generation)
+    {
+        t_thread.announced = g_generation;
+        append({{"ph", "M"}, {"name", "thread_name"}, {"pid", pid}, {"tid", t_thread.id}, {"args", {{"name", threadName().toStdString()}}}});
+    }
+    nlohmann::json event = {{"ph", "X"}, {"name", m_name}, {"cat", m_category}, {"pid", pid}, {"tid", t_thread.id},
+                            {"ts", micros(m_start - g_origin)}, {"dur", micros(end - m_start)}};
+    if (!m_args.empty())
+    {
+        nlohmann::json& args = event["args"];
+        for (const auto& [key, value] : m_args)
+            args[key] = value;
+    }
+    append(event);
+    if (g_pending.size() >= FLUSH_SIZE || end - g_lastFlush >= FLUSH_INTERVAL)
+        writePending();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroTrace)
+
+
+/**
+ * @brief Opt-in timeline of indexing and search in the Chrome trace event format.
+ *
+ * Between start() and stop(), every Span is written as a complete event with the id and name of
+ * its thread, so the file shows in chrome://tracing or https://ui.perfetto.dev how matches,
+ * searches and index updates overlap. Events are written as an unterminated JSON array, which
+ * both viewers accept, so a trace stays readable if the process dies before stop(). While
+ * tracing is off, a span costs one atomic load.
+ *
+ * The runner traces to the file named by the KRUNNER_ZOTERO_TRACE environment variable.
+ */
+namespace Trace
+{
+extern std::atomic<bool> g_enabled;
+
+[[nodiscard]] inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+/// Starts writing a new trace to @p path, replacing a running one
+bool start(const QString& path);
+/// Writes all pending events and closes the trace
+void stop();
+/// Writes all pending events, which otherwise happens once they add up to 64 KiB or are a second old
+void flush();
+
+class Span
+{
+public:
+    /// @param name and @p category must be string literals, they are only copied when the span ends
+    explicit Span(const char* name, const char* category = "index")
+        : m_name(name), m_category(category), m_active(enabled())
+    {
+        if (m_active)
+            m_start = std::chrono::steady_clock::now();
+    }
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /// Adds a numeric argument shown with the event, e.g. the number of items in a batch
+    void arg(const char* key, const std::int64_t value)
+    {
+        if (m_active)
+            m_args.emplace_back(key, value);
+    }
+
+private:
+    const char* m_name;
+    const char* m_category;
+    const bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<std::pair<const char*, std::int64_t>> m_args;
+};
+} // namespace Trace
@@ -4,23 +4,54 @@
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QStandardPaths>
+#include <QUrl>
 #include <QUuid>
 #include <generator>
+#include <memory>
 #include <optional>
+#include <stdexcept>
+#include <sqlite3.h>
+#include "stats.h"
 #include "zotero_item.h"
+#include "zotero_html.h"
+#include "zotero_item_batch.h"
+#include "zotero_json.h"
 
 Q_LOGGING_CATEGORY(KRunnerZoteroZotero, "krunner-zotero/zotero")
 
+namespace
+{
+std::string columnText(sqlite3_stmt *statement, const int column)
+{
+    // NULL becomes an empty string
+    const auto *text = reinterpret_cast<const char *>(sqlite3_column_text(statement, column));
+    return text == nullptr ? std::string() : std::string(text, sqlite3_column_bytes(statement, column));
+}
+} // namespace
+
 namespace ZoteroSQL
 {
-const auto query = QStringLiteral(R"(
-        WITH _Authors AS (SELECT itemCreators.itemID as parentID,
+// Every aggregate below only runs over _Items, the (non-deleted, top-level) items in %1. For incremental
+// updates %1 is just the items touched since the last update, so the cost scales with the changes.
+const auto queryTemplate = QStringLiteral(R"(
+        WITH _ChangedItems AS (%1),
+             _Items AS (SELECT items.itemID       AS itemID,
+                               items.dateModified AS dateModified,
+                               items.key          AS key
+                        FROM items
+                                 JOIN _ChangedItems ON items.itemID = _ChangedItems.itemID
+                                 LEFT JOIN itemTypes ON items.itemTypeID = itemTypes.itemTypeID
+                                 LEFT JOIN deletedItems ON items.itemID = deletedItems.itemID
+                        WHERE itemTypes.typeName NOT IN ('attachment', 'annotation', 'note')
+                          AND deletedItems.dateDeleted IS NULL
+                          AND items.itemID > :afterId),
+             _Authors AS (SELECT itemCreators.itemID as parentID,
                                  concat(
                                          creators.firstName, ' ', creators.lastName
                                  )                   as author
-                          FROM creators
-                                   LEFT JOIN itemCreators ON creators.creatorID = itemCreators.creatorID
-                                   LEFT JOIN creatorTypes ON itemCreators.creatorTypeID = creatorTypes.creatorTypeID
+                          FROM itemCreators
+                                   JOIN creators ON creators.creatorID = itemCreators.creatorID
+                          WHERE itemCreators.itemID IN (SELECT itemID FROM _Items)
                           ORDER BY itemCreators.orderIndex ASC),
              _ItemAuthors AS (SELECT parentID,
                                      json_group_array(author) as authors
@@ -33,6 +64,7 @@ const auto query = QStringLiteral(R"(
                            FROM itemData
                                     LEFT JOIN fields ON itemData.fieldID = fields.fieldID
                                     LEFT JOIN itemDataValues ON itemData.valueID = itemDataValues.valueID
+                           WHERE itemData.itemID IN (SELECT itemID FROM _Items)
                            GROUP BY itemData.itemID),
              _Attachments AS (SELECT itemAttachments.parentItemID AS parentID,
                                      items.key                    AS key,
@@ -46,6 +78,7 @@ const auto query = QStringLiteral(R"(
                                        LEFT JOIN itemData ON items.itemID = itemData.itemID
                                        LEFT JOIN fields ON itemData.fieldID = fields.fieldID
                                        LEFT JOIN itemDataValues ON itemData.valueID = itemDataValues.valueID
+                              WHERE itemAttachments.parentItemID IN (SELECT itemID FROM _Items)
                               GROUP BY itemAttachments.itemID),
              _ItemAttachments AS (SELECT parentID,
                                          json_group_array(
@@ -61,39 +94,77 @@ const auto query = QStringLiteral(R"(
                                   GROUP BY _Attachments.parentID),
              _ItemCollections AS (SELECT collectionItems.itemID                       AS parentID,
                                          json_group_array(collections.collectionName) AS collections
-                                  FROM collections
-                                           LEFT JOIN collectionItems ON collections.collectionID = collectionItems.collectionID
+                                  FROM collectionItems
+                                           JOIN collections ON collections.collectionID = collectionItems.collectionID
+                                  WHERE collectionItems.itemID IN (SELECT itemID FROM _Items)
                                   GROUP BY collectionItems.itemID),
              _ItemNotes AS (SELECT itemNotes.parentItemID           AS parentID,
                                    json_group_array(itemNotes.note) AS note
                             FROM itemNotes
+                            WHERE itemNotes.parentItemID IN (SELECT itemID FROM _Items)
                             GROUP BY itemNotes.parentItemID),
              _ItemTags AS (SELECT itemTags.itemID AS parentID, json_group_array(tags.name) AS tags
-                           FROM tags
-                                    LEFT JOIN itemTags ON tags.tagID = itemTags.tagID
+                           FROM itemTags
+                                    JOIN tags ON tags.tagID = itemTags.tagID
+                           WHERE itemTags.itemID IN (SELECT itemID FROM _Items)
                            GROUP BY itemTags.itemID)
-        SELECT items.itemID                                     AS id,
-               items.dateModified                               AS modified,
-               items.key                                        AS key,
+        SELECT _Items.itemID                                    AS id,
+               _Items.dateModified                              AS modified,
+               _Items.key                                       AS key,
                coalesce(_ItemAttachments.attachment_list, '[]') AS attachments,
                coalesce(_ItemCollections.collections, '[]')     AS collections,
                coalesce(_ItemMeta.meta, '{}')                   AS meta,
                coalesce(_ItemAuthors.authors, '[]')             AS authors,
                coalesce(_ItemNotes.note, '[]')                  AS note,
                coalesce(_ItemTags.tags, '[]')                   AS tags
-        FROM items
-                 LEFT JOIN itemTypes ON items.itemTypeID = itemTypes.itemTypeID
-                 LEFT JOIN deletedItems ON items.itemID = deletedItems.itemID
-                 LEFT JOIN _ItemMeta ON items.itemID = _ItemMeta.parentID
-                 LEFT JOIN _ItemAttachments ON items.itemID = _ItemAttachments.parentID
-                 LEFT JOIN _ItemCollections ON items.itemID = _ItemCollections.parentID
-                 LEFT JOIN _ItemAuthors ON items.itemID = _ItemAuthors.parentID
-                 LEFT JOIN _ItemNotes ON items.itemID = _ItemNotes.parentID
-                 LEFT JOIN _ItemTags ON items.itemID = _ItemTags.parentID
-        WHERE itemTypes.typeName NOT IN ('attachment', 'annotation', 'note')
-          AND deletedItems.dateDeleted IS NULL
+        FROM _Items
+                 LEFT JOIN _ItemMeta ON _Items.itemID = _ItemMeta.parentID
+                 LEFT JOIN _ItemAttachments ON _Items.itemID = _ItemAttachments.parentID
+                 LEFT JOIN _ItemCollections ON _Items.itemID = _ItemCollections.parentID
+                 LEFT JOIN _ItemAuthors ON _Items.itemID = _ItemAuthors.parentID
+                 LEFT JOIN _ItemNotes ON _Items.itemID = _ItemNotes.parentID
+                 LEFT JOIN _ItemTags ON _Items.itemID = _ItemTags.parentID
+        ORDER BY _Items.itemID
+        )");
+const auto query = queryTemplate.arg(QStringLiteral("SELECT itemID FROM items"));
+// Everything changed after a ZoteroChangeMark (bound as clientDateModified, version). Child notes and attachments
+// count as a change of their parent, a renamed collection as a change of its items. clientDateModified only has a
+// resolution of seconds, so changes in the very second of the mark are read again.
+const auto queryChangedSince = queryTemplate.arg(QStringLiteral(R"(
+            WITH _Since AS (SELECT ? AS clientDateModified, ? AS version),
+                 _ChangedObjects AS (SELECT items.itemID AS itemID
+                                     FROM items, _Since
+                                     WHERE items.clientDateModified >= _Since.clientDateModified
+                                        OR items.version > _Since.version)
+            SELECT itemID
+            FROM _ChangedObjects
+            UNION
+            SELECT itemNotes.parentItemID
+            FROM itemNotes
+                     JOIN _ChangedObjects ON itemNotes.itemID = _ChangedObjects.itemID
+            WHERE itemNotes.parentItemID IS NOT NULL
+            UNION
+            SELECT itemAttachments.parentItemID
+            FROM itemAttachments
+                     JOIN _ChangedObjects ON itemAttachments.itemID = _ChangedObjects.itemID
+            WHERE itemAttachments.parentItemID IS NOT NULL
+            UNION
+            SELECT collectionItems.itemID
+            FROM collectionItems
+                     JOIN collections ON collectionItems.collectionID = collections.collectionID,
+                 _Since
+            WHERE collections.clientDateModified >= _Since.clientDateModified
+               OR collections.version > _Since.version
+        )"));
+const auto queryChangeMark = QStringLiteral(R"(
+        SELECT max(coalesce((SELECT max(clientDateModified) FROM items), ''),
+                   coalesce((SELECT max(clientDateModified) FROM collections), '')) AS clientDateModified,
+               max(coalesce((SELECT max(version) FROM items), 0),
+                   coalesce((SELECT max(version) FROM collections), 0))            AS version,
+               (SELECT coalesce(sum(version), 0) FROM libraries)                   AS libraryVersion,
+               (SELECT count(*) FROM items)                                        AS itemCount,
+               (SELECT count(*) FROM deletedItems)                                 AS trashedCount
         )");
-const auto selectItemsByLastModified = query + QStringLiteral(" AND MODIFIED > ?");
 const auto selectMetadataByID = QStringLiteral(R"(
             SELECT  fields.fieldName AS name,
                     itemDataValues.value AS value
@@ -104,103 +175,258 @@ const auto selectMetadataByID = QStringLiteral(R"(
                     ON itemData.valueID = itemDataValues.valueID
                 WHERE itemData.itemID = ?
             )");
-const auto queryByLastModified = query + QStringLiteral(" AND MODIFIED > ?");
-// const auto queryValidIDs = QStringLiteral(R"(
-//         SELECT json_group_array(items.itemID) AS id
-//         FROM items
-//                  LEFT JOIN itemTypes ON items.itemTypeID = itemTypes.itemTypeID
-//                  LEFT JOIN deletedItems ON items.itemID = deletedItems.itemID
-//         WHERE itemTypes.typeName NOT IN ('attachment', 'annotation', 'note')
-//           AND deletedItems.dateDeleted IS NULL;
-//         )");
-const auto queryValidKeys = QStringLiteral(R"(
-        SELECT json_group_array(items.key) AS key
+const auto queryValidIds = QStringLiteral(R"(
+        SELECT items.itemID AS id
         FROM items
                  LEFT JOIN itemTypes ON items.itemTypeID = itemTypes.itemTypeID
                  LEFT JOIN deletedItems ON items.itemID = deletedItems.itemID
         WHERE itemTypes.typeName NOT IN ('attachment', 'annotation', 'note')
           AND deletedItems.dateDeleted IS NULL;
         )");
+const auto checkReadable = QStringLiteral("SELECT count(*) FROM sqlite_master");
 } // namespace ZoteroSQL
 
-QDateTime Zotero::lastModified() const { return QFileInfo(m_dbPath).lastModified(); }
+ZoteroSnapshot::ZoteroSnapshot(QString dbPath) : m_dbPath(std::move(dbPath)),
+                                                  m_connectionId(QUuid::createUuid().toString())
+{
+    const Stats::Timer timer(Stats::Phase::Snapshot);
+    const QFileInfo info(m_dbPath);
+    m_lastModified = info.lastModified();
+    m_size = info.size();
+    m_open = openImmutable() || openCopy();
+}
+
+ZoteroSnapshot::~ZoteroSnapshot()
+{
+    sqlite3_close(m_handle);
+    QSqlDatabase::removeDatabase(m_connectionId);
+    if (!m_copyPath.isEmpty())
+        QFile::remove(m_copyPath);
+}
 
-std::vector<std::string> Zotero::validKeys() const
+bool ZoteroSnapshot::unchanged() const
 {
-    std::vector<std::string> keys;
-    const auto dbConnectionId = QUuid::createUuid().toString();
-    const QString dbCopyPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + QStringLiteral("/krunner_zotero_%1.sqlite").arg(dbConnectionId);
-    if (QFile::exists(dbCopyPath))
-        QFile::remove(dbCopyPath);
-    QFile::copy(m_dbPath, dbCopyPath);
+    if (!m_copyPath.isEmpty())
+        return true;
+    const QFileInfo info(m_dbPath);
+    // a hot journal means Zotero was in the middle of a transaction
+    return info.lastModified() == m_lastModified && info.size() == m_size
+        && !QFileInfo::exists(m_dbPath + QStringLiteral("-journal"));
+}
 
+bool ZoteroSnapshot::openImmutable()
+{
+    QUrl uri = QUrl::fromLocalFile(QFileInfo(m_dbPath).absoluteFilePath());
+    uri.setQuery(QStringLiteral("immutable=1"));
     {
-        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), dbConnectionId);
-        db.setDatabaseName(dbCopyPath);
-        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
-        if (!db.open()) {
-            qCCritical(KRunnerZoteroZotero) << "Failed to open Zotero database: " << db.lastError().text();
-        }
-        QSqlQuery query(db);
-        if (!query.exec(ZoteroSQL::queryValidKeys)) {
-            qCCritical(KRunnerZoteroZotero) << "Failed to query valid IDs: " << query.lastError().text();
-        }
-        if (query.next()) {
-            auto jsonString = query.value(QStringLiteral("key")).toString().toStdString();
-            keys = json::parse(jsonString).get<std::vector<std::string>>();
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionId);
+        db.setDatabaseName(uri.toString(QUrl::FullyEncoded));
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_OPEN_URI"));
+        if (db.open())
+        {
+            // the file is only read lazily, so make sure it is actually readable
+            if (QSqlQuery query(db); query.exec(ZoteroSQL::checkReadable) && openHandle(db.databaseName()))
+            {
+                qCDebug(KRunnerZoteroZotero) << "Opened Zotero database in place:" << uri.toString();
+                return true;
+            }
         }
+        qCWarning(KRunnerZoteroZotero) << "Failed to open Zotero database in place: " << db.lastError().text();
     }
-    QSqlDatabase::removeDatabase(dbConnectionId);
-    QFile::remove(dbCopyPath);
-    return keys;
+    QSqlDatabase::removeDatabase(m_connectionId);
+    return false;
 }
 
-std::generator<const ZoteroItem &&> Zotero::items(const std::optional<const QDateTime> &lastModified) const
+bool ZoteroSnapshot::openCopy()
 {
-    const auto dbConnectionId = QUuid::createUuid().toString();
-    const QString dbCopyPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + QStringLiteral("/krunner_zotero_%1.sqlite").arg(dbConnectionId);
-    if (QFile::exists(dbCopyPath))
-        QFile::remove(dbCopyPath);
-    QFile::copy(m_dbPath, dbCopyPath);
-    {
-        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), dbConnectionId);
-        db.setDatabaseName(dbCopyPath);
-        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
-        if (!db.open()) {
-            qCCritical(KRunnerZoteroZotero) << "Failed to open Zotero database: " << db.lastError().text();
-            QFile::remove(dbCopyPath);
-            QSqlDatabase::removeDatabase(dbConnectionId);
-            co_return;
-        }
-        QSqlQuery query(db);
-        bool queryResult;
-        if (lastModified.has_value()) {
-            query.prepare(ZoteroSQL::queryByLastModified);
-            const auto lastModifiedStr = lastModified.value().toString(QStringLiteral("yyyy-MM-dd HH:mm:ss"));
-            query.addBindValue(lastModifiedStr);
-            queryResult = query.exec();
-        } else {
-            query.clear();
-            queryResult = query.exec(ZoteroSQL::query);
-        }
+    m_copyPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + QStringLiteral("/krunner_zotero_%1.sqlite").arg(m_connectionId);
+    if (QFile::exists(m_copyPath))
+        QFile::remove(m_copyPath);
+    QFile::copy(m_dbPath, m_copyPath);
 
-        if (!queryResult)
-            qCCritical(KRunnerZoteroZotero) << "Failed to query items:" << query.lastError().text();
-
-        while (query.next()) {
-            ZoteroItem item{.id = query.value(QStringLiteral("id")).toInt(),
-                            .key = query.value(QStringLiteral("key")).toString().toStdString(),
-                            .modified = query.value(QStringLiteral("modified")).toString().toStdString(),
-                            .meta = json::parse(query.value(QStringLiteral("meta")).toString().toStdString()),
-                            .attachments = json::parse(query.value(QStringLiteral("attachments")).toString().toStdString()).get<std::vector<Attachment>>(),
-                            .collections = json::parse(query.value(QStringLiteral("collections")).toString().toStdString()).get<std::vector<std::string>>(),
-                            .note = json::parse(query.value(QStringLiteral("note")).toString().toStdString()).get<std::vector<std::string>>(),
-                            .tags = json::parse(query.value(QStringLiteral("tags")).toString().toStdString()).get<std::vector<std::string>>(),
-                            .authors = json::parse(query.value(QStringLiteral("authors")).toString().toStdString()).get<std::vector<std::string>>()};
-            co_yield std::move(item);
-        }
+    auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionId);
+    db.setDatabaseName(m_copyPath);
+    db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+    if (!db.open()) {
+        qCCritical(KRunnerZoteroZotero) << "Failed to open Zotero database: " << db.lastError().text();
+        return false;
     }
+    return openHandle(m_copyPath);
+}
+
+bool ZoteroSnapshot::openHandle(const QString &name)
+{
+    const QByteArray path = name.toUtf8();
+    if (const int result = sqlite3_open_v2(path.constData(), &m_handle, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr);
+        result != SQLITE_OK) {
+        qCWarning(KRunnerZoteroZotero) << "Failed to open Zotero database: " << sqlite3_errstr(result);
+        // a handle is allocated even if opening failed
+        sqlite3_close(m_handle);
+        m_handle = nullptr;
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> Zotero::validIds() const
+{
+    const auto snapshot = this->snapshot();
+    return validIds(snapshot);
+}
+
+std::vector<int> Zotero::validIds(const ZoteroSnapshot &snapshot)
+{
+    std::vector<int> ids;
+    if (!snapshot.isOpen())
+        return ids;
+
+    QSqlQuery query(snapshot.database());
+    query.setForwardOnly(true);
+    if (!query.exec(ZoteroSQL::queryValidIds)) {
+        qCCritical(KRunnerZoteroZotero) << "Failed to query valid IDs: " << query.lastError().text();
+        return ids;
+    }
+    while (query.next()) {
+        ids.push_back(query.value(0).toInt());
+    }
+    return ids;
+}
+
+std::optional<ZoteroChangeMark> Zotero::changeMark(const ZoteroSnapshot &snapshot)
+{
+    if (!snapshot.isOpen())
+        return std::nullopt;
+
+    QSqlQuery query(snapshot.database());
+    if (!query.exec(ZoteroSQL::queryChangeMark) || !query.next()) {
+        qCCritical(KRunnerZoteroZotero) << "Failed to query change mark:" << query.lastError().text();
+        return std::nullopt;
+    }
+    return ZoteroChangeMark{.clientDateModified = query.value(0).toString(),
+                            .version = query.value(1).toLongLong(),
+                            .libraryVersion = query.value(2).toLongLong(),
+                            .itemCount = query.value(3).toLongLong(),
+                            .trashedCount = query.value(4).toLongLong()};
+}
+
+std::generator<const ZoteroItem &&> Zotero::items(const std::optional<ZoteroChangeMark> &since) const
+{
+    const auto snapshot = this->snapshot();
+    co_yield std::ranges::elements_of(items(snapshot, since));
+}
+
+std::generator<const ZoteroItem &&> Zotero::items(const ZoteroSnapshot &snapshot, const std::optional<ZoteroChangeMark> &since)
+{
+    // one item at a time, the batch is reused for the next one after the consumer is done with it
+    ZoteroItemBatch batch;
+    for (const ZoteroRow &row : rows(snapshot, since)) {
+        batch.clear();
+        decode(row, batch);
+        co_yield ZoteroItem(batch.items().back());
+    }
+}
+
+std::generator<ZoteroRow &&> Zotero::rows(const ZoteroSnapshot &snapshot, const std::optional<ZoteroChangeMark> &since, const int afterId)
+{
+    if (!snapshot.isOpen())
+        throw std::runtime_error("Zotero database is not open");
+
+    // only the time spent in SQLite counts, not the time the consumer takes between rows
+    Stats::Accumulator extraction(Stats::Phase::Extract);
+    extraction.start();
+
+    // rows are read through the SQLite API, so their text stays UTF-8 all the way into ZoteroItem
+    sqlite3 *handle = snapshot.handle();
+    const QByteArray sql = (since.has_value() ? ZoteroSQL::queryChangedSince : ZoteroSQL::query).toUtf8();
+    sqlite3_stmt *statement = nullptr;
+    if (sqlite3_prepare_v2(handle, sql.constData(), static_cast<int>(sql.size()), &statement, nullptr) != SQLITE_OK)
+        throw std::runtime_error(std::string("Failed to query items: ") + sqlite3_errmsg(handle));
+    const std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> finalizer(statement, &sqlite3_finalize);
+    if (since.has_value()) {
+        const QByteArray clientDateModified = since->clientDateModified.toUtf8();
+        sqlite3_bind_text(statement, 1, clientDateModified.constData(), static_cast<int>(clientDateModified.size()), SQLITE_TRANSIENT);
+        sqlite3_bind_int64(statement, 2, since->version);
+    }
+    sqlite3_bind_int(statement, sqlite3_bind_parameter_index(statement, ":afterId"), afterId);
+
+    // columns by position, in the order of the SELECT in queryTemplate
+    int result;
+    while ((result = sqlite3_step(statement)) == SQLITE_ROW) {
+        ZoteroRow row{.id = sqlite3_column_int(statement, 0),
+                      .key = columnText(statement, 2),
+                      .modified = columnText(statement, 1),
+                      .meta = columnText(statement, 5),
+                      .attachments = columnText(statement, 3),
+                      .collections = columnText(statement, 4),
+                      .note = columnText(statement, 7),
+                      .tags = columnText(statement, 8),
+                      .authors = columnText(statement, 6)};
+        extraction.stop();
+        co_yield std::move(row);
+        extraction.start();
+    }
+    extraction.stop();
+    // the rows so far are fine, but the consumer must not take them for all of them
+    if (result != SQLITE_DONE)
+        throw std::runtime_error(std::string("Failed to read items: ") + sqlite3_errmsg(handle));
+}
+
+void Zotero::decode(const ZoteroRow &row, ZoteroItemBatch &batch)
+{
+    const Stats::Timer timer(Stats::Phase::Decode);
+    ZoteroItem item;
+    item.id = row.id;
+    item.key = batch.copy(row.key);
+    item.modified = batch.copy(row.modified);
+
+    ZoteroJson::parseStringMap(row.meta, [&item, &batch](const std::string_view name, const std::string_view value) {
+        if (const auto field = zoteroField(name); field.has_value())
+            item.fields[static_cast<std::size_t>(field.value())] = batch.copy(value);
+    });
+
+    // lists are collected here and copied into the batch in one piece once their length is known
+    thread_local std::vector<Attachment> attachments;
+    attachments.clear();
+    ZoteroJson::parseAttachments(
+        row.attachments,
+        []() { attachments.emplace_back(); },
+        [&batch](const std::string_view name, const std::string_view value) {
+            auto &attachment = attachments.back();
+            if (name == "key")
+                attachment.key = batch.copy(value);
+            else if (name == "path")
+                attachment.path = batch.copy(value);
+            else if (name == "title")
+                attachment.title = batch.intern(value);
+            else if (name == "url")
+                attachment.url = batch.copy(value);
+            else if (name == "contentType")
+                attachment.contentType = batch.intern(value);
+        });
+    item.attachments = batch.copy(std::span<const Attachment>(attachments));
+
+    thread_local std::vector<std::string_view> values;
+    const auto parseList = [&batch](const std::string &json, const bool interned) {
+        values.clear();
+        ZoteroJson::parseStringArray(json, [&batch, interned](const std::string_view value) {
+            values.push_back(interned ? batch.intern(value) : batch.copy(value));
+        });
+        return batch.copy(std::span<const std::string_view>(values));
+    };
+    item.collections = parseList(row.collections, true);
+    // notes are indexed as plain text, the markup and embedded images would only pollute the index
+    thread_local std::string text;
+    values.clear();
+    ZoteroJson::parseStringArray(row.note, [&batch](const std::string_view note) {
+        text.clear();
+        ZoteroHtml::appendText(note, text);
+        if (!text.empty())
+            values.push_back(batch.copy(text));
+    });
+    item.note = batch.copy(std::span<const std::string_view>(values));
+    item.tags = parseList(row.tags, true);
+    item.authors = parseList(row.authors, true);
 
-    QSqlDatabase::removeDatabase(dbConnectionId);
-    QFile::remove(dbCopyPath);
+    batch.add(item);
+    Stats::add(Stats::Counter::ItemsDecoded);
 }
@@ -2,23 +2,128 @@
 
 #include <QLoggingCategory>
 #include <QDateTime>
+#include <QSqlDatabase>
 #include <QString>
 #include <generator>
+#include <optional>
+#include <string>
 #include <utility>
-#include "zotero_item.h"
+#include "zotero_item_batch.h"
+
+struct sqlite3;
 
 Q_DECLARE_LOGGING_CATEGORY(KRunnerZoteroZotero)
 
 
+/**
+ * @brief High-water mark of the changes in a Zotero database, see Zotero::changeMark().
+ *
+ * Every local edit bumps the clientDateModified of the item (or collection) and every synced change
+ * its version, so everything after a mark can be queried exactly. The counts catch deletions, which
+ * leave no row behind.
+ */
+struct ZoteroChangeMark
+{
+    QString clientDateModified; // UTC "yyyy-MM-dd HH:mm:ss", as stored by Zotero
+    qint64 version = 0;         // highest sync version of any item or collection
+    qint64 libraryVersion = 0;
+    qint64 itemCount = 0;
+    qint64 trashedCount = 0;
+
+    bool operator==(const ZoteroChangeMark&) const = default;
+};
+
+
+/// One undecoded row of the item query as UTF-8, see Zotero::rows() and Zotero::decode()
+struct ZoteroRow
+{
+    int id = 0;
+    std::string key;
+    std::string modified;
+    // JSON
+    std::string meta;
+    std::string attachments;
+    std::string collections;
+    std::string note;
+    std::string tags;
+    std::string authors;
+};
+
+
+/**
+ * @brief Read-only view of the Zotero database, shared by all reads of one index update.
+ *
+ * Zotero keeps its database exclusively locked while it is running, so regular SQLite readers fail
+ * with "database is locked". The live file is therefore opened as an immutable URI, which skips
+ * locking altogether and does not copy anything. Only if that fails the database is copied to the
+ * temp dir, as older versions always did.
+ *
+ * As the file is not locked, Zotero may write to it while it is being read; unchanged() tells the
+ * reader whether it has to assume that it missed such a write.
+ *
+ * Besides the Qt connection, the snapshot opens the same file with the SQLite library linked by
+ * krunner-zotero, whose handle the item query runs on. Qt's driver may use a SQLite of its own, so
+ * its handle is never used directly.
+ */
+class ZoteroSnapshot
+{
+public:
+    explicit ZoteroSnapshot(QString dbPath);
+    ~ZoteroSnapshot();
+
+    ZoteroSnapshot(const ZoteroSnapshot&) = delete;
+    ZoteroSnapshot& operator=(const ZoteroSnapshot&) = delete;
+
+    [[nodiscard]] bool isOpen() const { return m_open; }
+    [[nodiscard]] QSqlDatabase database() const { return QSqlDatabase::database(m_connectionId, false); }
+    /// Read-only connection of the linked SQLite library to the same file as database()
+    [[nodiscard]] sqlite3* handle() const { return m_handle; }
+    /// Whether the Zotero database is still the same file state as when the snapshot was opened
+    [[nodiscard]] bool unchanged() const;
+
+private:
+    const QString m_dbPath;
+    const QString m_connectionId;
+    QString m_copyPath;
+    QDateTime m_lastModified;
+    qint64 m_size = -1;
+    sqlite3* m_handle = nullptr;
+    bool m_open = false;
+
+    bool openImmutable();
+    bool openCopy();
+    bool openHandle(const QString& name);
+};
+
+
 class Zotero
 {
 public:
     explicit Zotero(QString dbPath) : m_dbPath(std::move(dbPath)) {}
     ~Zotero() = default;
-    [[nodiscard]] QDateTime lastModified() const;
+    [[nodiscard]] ZoteroSnapshot snapshot() const { return ZoteroSnapshot(m_dbPath); }
+    /// Items changed after @p since, or all items, throws std::runtime_error like rows() and decode()
     [[nodiscard]] std::generator<const ZoteroItem&&>
-    items(const std::optional<const QDateTime> &lastModified = std::nullopt) const;
-    [[nodiscard]] std::vector<std::string> validKeys() const;
+    items(const std::optional<ZoteroChangeMark> &since = std::nullopt) const;
+    [[nodiscard]] static std::generator<const ZoteroItem&&>
+    items(const ZoteroSnapshot &snapshot, const std::optional<ZoteroChangeMark> &since = std::nullopt);
+    /**
+     * @brief Rows of the items changed after @p since, or of all items, without decoding them.
+     *
+     * Rows come in the order of their item IDs, and only those with an ID above @p afterId, so an
+     * interrupted read can be resumed. Fetching has to happen on the snapshot's thread, decoding is
+     * thread-safe and may happen elsewhere.
+     *
+     * Throws std::runtime_error if the query fails, also after some rows were already yielded.
+     */
+    [[nodiscard]] static std::generator<ZoteroRow&&>
+    rows(const ZoteroSnapshot &snapshot, const std::optional<ZoteroChangeMark> &since = std::nullopt, int afterId = 0);
+    /// Decodes @p row into an item of @p batch, throws std::runtime_error if its JSON is malformed
+    static void decode(const ZoteroRow &row, ZoteroItemBatch &batch);
+    /// Reads the current change mark, which is a single cheap query
+    [[nodiscard]] static std::optional<ZoteroChangeMark> changeMark(const ZoteroSnapshot &snapshot);
+    [[nodiscard]] std::vector<int> validIds() const;
+    [[nodiscard]] static std::vector<int> validIds(const ZoteroSnapshot &snapshot);
 
 private:
     const QString m_dbPath;
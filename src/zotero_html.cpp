@@ -0,0 +1,318 @@
+#include "zotero_html.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+
+namespace
+{
+constexpr bool isSpace(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+constexpr bool isAlpha(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool isAlnum(const char c)
+{
+    return isAlpha(c) || (c >= '0' && c <= '9');
+}
+
+constexpr char toLower(const char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// bytes that end a run of text
+constexpr auto STOP_BYTES = []()
+{
+    std::array<bool, 256> stop{};
+    for (const char c : std::string_view("<& \t\n\r\f"))
+        stop[static_cast<unsigned char>(c)] = true;
+    return stop;
+}();
+
+// tags that separate the words around them; all others, like <strong> or <a>, may be in the middle of a word
+constexpr std::array<std::string_view, 37> BLOCK_TAGS = {
+    "address", "article", "aside", "blockquote", "br", "caption", "dd", "div", "dl", "dt", "figcaption", "figure", "footer",
+    "h1", "h2", "h3", "h4", "h5", "h6", "header", "hr", "img", "li", "main", "nav", "ol", "p", "pre", "section", "table",
+    "tbody", "td", "tfoot", "th", "thead", "tr", "ul",
+};
+static_assert(std::ranges::is_sorted(BLOCK_TAGS));
+
+// tags whose content is not text
+constexpr std::array<std::string_view, 2> RAW_TAGS = {"script", "style"};
+
+// the named character references found in notes written with the Zotero editor or pasted from the web
+constexpr std::array<std::pair<std::string_view, std::string_view>, 26> ENTITIES = {{
+    {"amp", "&"},       {"apos", "'"},      {"bull", "•"},   {"copy", "©"},  {"deg", "°"},   {"euro", "€"},
+    {"gt", ">"},        {"hellip", "…"}, {"laquo", "«"}, {"ldquo", "“"}, {"lsquo", "‘"}, {"lt", "<"},
+    {"mdash", "—"}, {"middot", "·"}, {"nbsp", " "},      {"ndash", "–"}, {"quot", "\""},      {"raquo", "»"},
+    {"rdquo", "”"}, {"reg", "®"},  {"rsquo", "’"},  {"shy", ""},         {"thinsp", " "},     {"times", "×"},
+    {"trade", "™"}, {"zwsp", ""},
+}};
+static_assert(std::ranges::is_sorted(ENTITIES));
+constexpr std::size_t MAX_ENTITY_LENGTH = 6;
+
+/// Appends words with single spaces between them, a pending space is only written before the next word
+class TextWriter
+{
+public:
+    explicit TextWriter(std::string& text) : m_text(text) {}
+
+    void space() { m_space = true; }
+    void write(const std::string_view text)
+    {
+        if (text.empty())
+            return;
+        if (m_space && !m_text.empty())
+            m_text += ' ';
+        m_space = false;
+        m_text.append(text);
+    }
+
+private:
+    std::string& m_text;
+    bool m_space = true;
+};
+
+class Normalizer
+{
+public:
+    Normalizer(const std::string_view html, std::string& text) : m_html(html), m_writer(text) {}
+
+    void run()
+    {
+        while (m_pos < m_html.size())
+        {
+            const char c = m_html[m_pos];
+            if (c == '<')
+                markup();
+            else if (c == '&')
+                reference();
+            else if (isSpace(c))
+            {
+                m_writer.space();
+                ++m_pos;
+            }
+            else
+                word(m_pos);
+        }
+    }
+
+private:
+    const std::string_view m_html;
+    TextWriter m_writer;
+    std::size_t m_pos = 0;
+
+    /// Writes the text from @p start up to the next markup, reference or whitespace
+    void word(const std::size_t start)
+    {
+        std::size_t end = start + 1;
+        while (end < m_html.size() && !STOP_BYTES[static_cast<unsigned char>(m_html[end])])
+            ++end;
+        const std::string_view word = m_html.substr(start, end - start);
+        // a data URI pasted as text is as useless to search as one in an attribute
+        if (!(word.starts_with("data:") && word.find(";base64,") != std::string_view::npos))
+            m_writer.write(word);
+        m_pos = end;
+    }
+
+    /// Skips past @p terminator, or to the end of the note if it is missing
+    void skipPast(const std::string_view terminator)
+    {
+        const auto end = m_html.find(terminator, m_pos);
+        m_pos = end == std::string_view::npos ? m_html.size() : end + terminator.size();
+    }
+
+    /// Skips the attributes of a tag up to its closing '>', quoted values may contain '>'
+    void skipAttributes()
+    {
+        while (m_pos < m_html.size())
+        {
+            const char c = m_html[m_pos++];
+            if (c == '>')
+                return;
+            if (c == '"' || c == '\'')
+            {
+                const auto end = m_html.find(c, m_pos);
+                m_pos = end == std::string_view::npos ? m_html.size() : end + 1;
+            }
+        }
+    }
+
+    /// Reads a tag name at the current position, lowercased; longer names than any known tag come back empty
+    std::string_view tagName(std::array<char, 16>& buffer)
+    {
+        std::size_t length = 0;
+        bool known = true;
+        while (m_pos < m_html.size() && (isAlnum(m_html[m_pos]) || m_html[m_pos] == '-'))
+        {
+            if (length < buffer.size())
+                buffer[length++] = toLower(m_html[m_pos]);
+            else
+                known = false;
+            ++m_pos;
+        }
+        return known ? std::string_view(buffer.data(), length) : std::string_view();
+    }
+
+    /// Skips the content of a script or style element, up to and including its end tag
+    void skipRawText(const std::string_view name)
+    {
+        while (m_pos < m_html.size())
+        {
+            skipPast("</");
+            std::array<char, 16> buffer{};
+            if (tagName(buffer) == name)
+            {
+                skipAttributes();
+                return;
+            }
+        }
+    }
+
+    void markup()
+    {
+        const std::string_view rest = m_html.substr(m_pos);
+        if (rest.starts_with("<!--"))
+        {
+            m_pos += 4;
+            skipPast("-->");
+            return;
+        }
+        const bool closing = rest.size() > 1 && rest[1] == '/';
+        const std::size_t nameStart = closing ? 2 : 1;
+        if (rest.size() > 1 && (rest[1] == '!' || rest[1] == '?'))
+        {
+            // doctype, CDATA or a processing instruction
+            skipPast(">");
+            return;
+        }
+        if (rest.size() <= nameStart || !isAlpha(rest[nameStart]))
+        {
+            // a lone '<', as in "p < 0.05"
+            m_writer.write("<");
+            ++m_pos;
+            return;
+        }
+
+        m_pos += nameStart;
+        std::array<char, 16> buffer{};
+        const std::string_view name = tagName(buffer);
+        skipAttributes();
+        if (std::ranges::binary_search(BLOCK_TAGS, name))
+            m_writer.space();
+        else if (!closing && std::ranges::find(RAW_TAGS, name) != RAW_TAGS.end())
+        {
+            skipRawText(name);
+            m_writer.space();
+        }
+    }
+
+    void reference()
+    {
+        const std::string_view rest = m_html.substr(m_pos + 1);
+        if (rest.starts_with('#'))
+        {
+            numericReference(rest);
+            return;
+        }
+
+        std::size_t length = 0;
+        while (length < rest.size() && length <= MAX_ENTITY_LENGTH && isAlnum(rest[length]))
+            ++length;
+        const std::string_view name = rest.substr(0, length);
+        const auto entity = std::ranges::lower_bound(ENTITIES, name, {}, &std::pair<std::string_view, std::string_view>::first);
+        if (length < rest.size() && rest[length] == ';' && entity != ENTITIES.end() && entity->first == name)
+        {
+            if (entity->second == " ")
+                m_writer.space();
+            else
+                m_writer.write(entity->second);
+            m_pos += 1 + length + 1;
+            return;
+        }
+        // not a reference we know, kept as written
+        m_writer.write("&");
+        ++m_pos;
+    }
+
+    /// Decodes &#NNN; and &#xHHH;, the ';' may be missing
+    void numericReference(const std::string_view rest)
+    {
+        const bool hex = rest.size() > 1 && toLower(rest[1]) == 'x';
+        std::size_t end = hex ? 2 : 1;
+        std::uint32_t code = 0;
+        const std::size_t digitsStart = end;
+        for (; end < rest.size() && end - digitsStart < 8; ++end)
+        {
+            const char c = toLower(rest[end]);
+            if (c >= '0' && c <= '9')
+                code = code * (hex ? 16 : 10) + static_cast<std::uint32_t>(c - '0');
+            else if (hex && c >= 'a' && c <= 'f')
+                code = code * 16 + static_cast<std::uint32_t>(c - 'a' + 10);
+            else
+                break;
+        }
+        if (end == digitsStart)
+        {
+            m_writer.write("&");
+            ++m_pos;
+            return;
+        }
+        if (end < rest.size() && rest[end] == ';')
+            ++end;
+        m_pos += 1 + end;
+
+        if (code < 0x80 && (isSpace(static_cast<char>(code)) || code == 0))
+            m_writer.space();
+        else if (code == 0xa0 || code == 0x2009)
+            m_writer.space();
+        else if (code != 0xad && code != 0x200b)
+            writeUtf8(code);
+    }
+
+    void writeUtf8(std::uint32_t code)
+    {
+        if (code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff))
+            code = 0xfffd;
+        std::array<char, 4> bytes{};
+        std::size_t length = 0;
+        if (code < 0x80)
+        {
+            bytes[length++] = static_cast<char>(code);
+        }
+        else if (code < 0x800)
+        {
+            bytes[length++] = static_cast<char>(0xc0 | (code >> 6));
+            bytes[length++] = static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            bytes[length++] = static_cast<char>(0xe0 | (code >> 12));
+            bytes[length++] = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            bytes[length++] = static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            bytes[length++] = static_cast<char>(0xf0 | (code >> 18));
+            bytes[length++] = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            bytes[length++] = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            bytes[length++] = static_cast<char>(0x80 | (code & 0x3f));
+        }
+        m_writer.write(std::string_view(bytes.data(), length));
+    }
+};
+} // namespace
+
+
+void ZoteroHtml::appendText(const std::string_view html, std::string& text)
+{
+    Normalizer(html, text).run();
+}
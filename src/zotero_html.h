@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+
+/**
+ * Plain text of the HTML notes Zotero stores, for indexing.
+ *
+ * Notes are the largest column of the item query and mostly markup: schema wrappers, citation spans
+ * with URL-encoded JSON attributes and embedded images as base64 data URIs. Indexing them as they
+ * are fills the FTS vocabulary with attribute names and base64 fragments. This is a single forward
+ * pass over the UTF-8 bytes that drops tags, comments, scripts and styles, decodes character
+ * references and collapses whitespace, appending the result to a reused buffer so that a whole
+ * batch of notes is normalized without allocating. Block-level tags separate words, inline tags
+ * do not. It is not a validating parser: malformed markup degrades to text instead of failing.
+ */
+namespace ZoteroHtml
+{
+/// Appends the text of @p html to @p text, separated from text already there by a space
+void appendText(std::string_view html, std::string& text);
+} // namespace ZoteroHtml
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <QDateTime>
 #include <QRegularExpression>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -11,34 +18,101 @@ using namespace nlohmann::literals;
 const QRegularExpression ZOTERO_DATE_REGEX(QStringLiteral(R"((\d{4})-(\d{2})-(\d{2}).*)"));
 
 
-struct Attachment
+inline QString zoteroYear(const QString& date)
+{
+    const QRegularExpressionMatch match = ZOTERO_DATE_REGEX.match(date);
+    return match.hasMatch() ? match.captured(1) : date.left(4);
+}
+
+inline QString zoteroAuthorSummary(const std::size_t count, const QString& first, const QString& last)
+{
+    if (count == 0)
+    {
+        return {};
+    }
+    if (count == 1)
+    {
+        return first;
+    }
+    if (count == 2)
+    {
+        return first + QStringLiteral(" and ") + last;
+    }
+    return first + QStringLiteral(" et al.");
+}
+
+
+/**
+ * Item fields the index uses, every other Zotero field is dropped while decoding.
+ * The names are the ones of Zotero's fields table.
+ */
+enum class ZoteroField : std::uint8_t
 {
-    std::string key;
-    std::string path; // storage:Mirzadeh2022ArchitectureMattersContinualLearning.pdf
-    std::string title; // Preprint PDF
-    std::string url; // http://arxiv.org/pdf/2202.00275v1
-    std::string contentType; // application/pdf
+    title,
+    shortTitle,
+    DOI,
+    abstractNote,
+    caseName,
+    nameOfAct,
+    subject,
+    dateEnacted,
+    dateDecided,
+    filingDate,
+    issueDate,
+    date,
+    publisher,
+    journalAbbreviation,
+    conferenceName,
+    proceedingsTitle,
+    websiteTitle,
 };
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Attachment, key, path, title, url, contentType)
+constexpr std::array<std::string_view, 17> ZOTERO_FIELD_NAMES = {
+    "title", "shortTitle", "DOI", "abstractNote", "caseName", "nameOfAct", "subject",
+    "dateEnacted", "dateDecided", "filingDate", "issueDate", "date",
+    "publisher", "journalAbbreviation", "conferenceName", "proceedingsTitle", "websiteTitle",
+};
+static_assert(ZOTERO_FIELD_NAMES.size() == static_cast<std::size_t>(ZoteroField::websiteTitle) + 1);
+
+inline std::optional<ZoteroField> zoteroField(const std::string_view name)
+{
+    if (const auto it = std::ranges::find(ZOTERO_FIELD_NAMES, name); it != ZOTERO_FIELD_NAMES.end())
+    {
+        return static_cast<ZoteroField>(it - ZOTERO_FIELD_NAMES.begin());
+    }
+    return std::nullopt;
+}
+
+
+// all strings of an attachment or item point into the ZoteroItemBatch it was decoded into
+struct Attachment
+{
+    std::string_view key;
+    std::string_view path; // storage:Mirzadeh2022ArchitectureMattersContinualLearning.pdf
+    std::string_view title; // Preprint PDF
+    std::string_view url; // http://arxiv.org/pdf/2202.00275v1
+    std::string_view contentType; // application/pdf
+};
 
 
 struct ZoteroItem
 {
-    int id;
-    std::string key; // TP6IKMQ6
-    std::string modified;
-    std::unordered_map<std::string, std::string> meta;
+    int id = 0;
+    std::string_view key; // TP6IKMQ6
+    std::string_view modified;
+    std::array<std::string_view, ZOTERO_FIELD_NAMES.size()> fields{}; // by ZoteroField, empty if unset
+
+    std::span<const Attachment> attachments;
+    std::span<const std::string_view> collections;
+    std::span<const std::string_view> note;
+    std::span<const std::string_view> tags;
+    std::span<const std::string_view> authors;
 
-    std::vector<Attachment> attachments;
-    std::vector<std::string> collections;
-    std::vector<std::string> note;
-    std::vector<std::string> tags;
-    std::vector<std::string> authors;
+    [[nodiscard]] std::string_view field(const ZoteroField field) const { return fields[static_cast<std::size_t>(field)]; }
 
     [[nodiscard]] QDateTime modifiedDateTime() const
     {
-        return QDateTime::fromString(QString::fromStdString(modified), QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+        return QDateTime::fromString(QString::fromUtf8(modified), QStringLiteral("yyyy-MM-dd hh:mm:ss"));
     }
 
     QString authorSummary() const
@@ -47,29 +121,72 @@ struct ZoteroItem
         {
             return {};
         }
-        if (authors.size() == 1)
+        return zoteroAuthorSummary(authors.size(), QString::fromUtf8(authors.front()), QString::fromUtf8(authors.back()));
+    }
+
+    /// Title to show for the item, falling back to the fields some item types use instead of a title
+    [[nodiscard]] std::string_view displayTitle() const
+    {
+        for (const auto titleField : {ZoteroField::title, ZoteroField::caseName, ZoteroField::nameOfAct, ZoteroField::subject, ZoteroField::shortTitle})
         {
-            return QString::fromStdString(authors.front());
+            if (const auto value = field(titleField); !value.empty())
+            {
+                return value;
+            }
         }
-        if (authors.size() == 2)
+        return key;
+    }
+
+    /// Key of the first PDF attachment, empty if there is none
+    [[nodiscard]] std::string_view pdfKey() const
+    {
+        for (const auto& attachment : attachments)
         {
-            return QString::fromStdString(authors.front()) + QStringLiteral(" and ") + QString::fromStdString(authors.back());
+            if (attachment.contentType == "application/pdf")
+            {
+                return attachment.key;
+            }
         }
-        return QString::fromStdString(authors.front()) + QStringLiteral(" et al.");
+        return {};
     }
 
-    QString year() const
+    /// Raw value of the most relevant date field, empty if the item has none
+    [[nodiscard]] std::string_view date() const
     {
-        for (const auto dateKey : {"dateEnacted", "dateDecided", "filingDate", "issueDate", "date"})
+        for (const auto dateField : {ZoteroField::dateEnacted, ZoteroField::dateDecided, ZoteroField::filingDate, ZoteroField::issueDate, ZoteroField::date})
         {
-            if (const auto it = meta.find(dateKey); it != meta.end())
+            if (const auto value = field(dateField); !value.empty())
             {
-                const auto dateValue = QString::fromStdString(it->second);
-                const QRegularExpressionMatch match = ZOTERO_DATE_REGEX.match(dateValue);
-                return match.hasMatch() ? match.captured(1) : dateValue.left(4);
+                return value;
             }
         }
         return {};
     }
+
+    QString year() const
+    {
+        return zoteroYear(QString::fromUtf8(date()));
+    }
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ZoteroItem, id, key, modified, meta, attachments, collections, note, tags, authors)
\ No newline at end of file
+
+
+inline void to_json(json& j, const Attachment& attachment)
+{
+    j = {{"key", attachment.key}, {"path", attachment.path}, {"title", attachment.title},
+         {"url", attachment.url}, {"contentType", attachment.contentType}};
+}
+
+inline void to_json(json& j, const ZoteroItem& item)
+{
+    json meta = json::object();
+    for (std::size_t i = 0; i < item.fields.size(); ++i)
+    {
+        if (!item.fields[i].empty())
+        {
+            meta[std::string(ZOTERO_FIELD_NAMES[i])] = item.fields[i];
+        }
+    }
+    j = {{"id", item.id}, {"key", item.key}, {"modified", item.modified}, {"meta", std::move(meta)},
+         {"attachments", item.attachments}, {"collections", item.collections}, {"note", item.note},
+         {"tags", item.tags}, {"authors", item.authors}};
+}
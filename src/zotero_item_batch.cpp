@@ -0,0 +1,34 @@
+#include "zotero_item_batch.h"
+
+#include <cstring>
+
+namespace
+{
+// first block of the arena, a batch of a few dozen items with notes usually fits into a few blocks
+constexpr std::size_t ARENA_INITIAL_SIZE = 16 * 1024;
+} // namespace
+
+
+ZoteroItemBatch::ZoteroItemBatch() : m_memory(std::make_unique<Memory>(ARENA_INITIAL_SIZE)) {}
+
+std::string_view ZoteroItemBatch::copy(const std::string_view str)
+{
+    if (str.empty())
+        return {};
+    auto* data = static_cast<char*>(m_memory->arena.allocate(str.size(), alignof(char)));
+    std::memcpy(data, str.data(), str.size());
+    return {data, str.size()};
+}
+
+std::string_view ZoteroItemBatch::intern(const std::string_view str)
+{
+    if (const auto it = m_memory->interned.find(str); it != m_memory->interned.end())
+        return *it;
+    return *m_memory->interned.insert(copy(str)).first;
+}
+
+void ZoteroItemBatch::clear()
+{
+    m_items.clear();
+    m_memory = std::make_unique<Memory>(ARENA_INITIAL_SIZE);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "zotero_item.h"
+
+
+/**
+ * @brief A batch of decoded items together with the memory their strings live in.
+ *
+ * All strings and lists of the items are allocated from one monotonic arena that is freed with
+ * the batch, so decoding an item costs a handful of bump allocations instead of one heap
+ * allocation per string. Author names, tags and collections repeat a lot and are interned, so
+ * each distinct one is stored once per batch. Items must not outlive their batch; moving the
+ * batch keeps them valid, a moved-from batch has to be cleared before it is used again.
+ */
+class ZoteroItemBatch
+{
+public:
+    ZoteroItemBatch();
+    ZoteroItemBatch(ZoteroItemBatch&&) noexcept = default;
+    ZoteroItemBatch& operator=(ZoteroItemBatch&&) noexcept = default;
+
+    [[nodiscard]] std::string_view copy(std::string_view str);
+    /// Like copy(), but returns the earlier copy if the same string was already interned
+    [[nodiscard]] std::string_view intern(std::string_view str);
+    template <typename T>
+    [[nodiscard]] std::span<const T> copy(const std::span<const T> values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (values.empty())
+            return {};
+        T* data = std::pmr::polymorphic_allocator<T>(&m_memory->arena).allocate(values.size());
+        std::ranges::copy(values, data);
+        return {data, values.size()};
+    }
+
+    void add(const ZoteroItem& item) { m_items.push_back(item); }
+    /// Drops all items and frees their memory
+    void clear();
+
+    [[nodiscard]] const std::vector<ZoteroItem>& items() const { return m_items; }
+    [[nodiscard]] auto begin() const { return m_items.begin(); }
+    [[nodiscard]] auto end() const { return m_items.end(); }
+    [[nodiscard]] std::size_t size() const { return m_items.size(); }
+    [[nodiscard]] bool empty() const { return m_items.empty(); }
+
+private:
+    // behind a pointer, so moving the batch does not move the memory the items point into
+    struct Memory
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::unordered_set<std::string_view> interned{&arena};
+
+        explicit Memory(std::size_t initialSize) : arena(initialSize) {}
+    };
+
+    std::unique_ptr<Memory> m_memory;
+    std::vector<ZoteroItem> m_items;
+};
@@ -0,0 +1,157 @@
+#include "zotero_json.h"
+
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace
+{
+/**
+ * Turns all scalar SAX events into value() calls with their text and tracks the nesting depth.
+ * Subclasses accept values and keys at the depths of their shape only.
+ */
+class ScalarSax : public nlohmann::json_sax<json>
+{
+public:
+    bool null() override { return nullValue(); }
+    bool boolean(const bool val) override { return value(val ? "true" : "false"); }
+    bool number_integer(const number_integer_t val) override { return value(std::to_string(val)); }
+    bool number_unsigned(const number_unsigned_t val) override { return value(std::to_string(val)); }
+    bool number_float(number_float_t, const string_t& s) override { return value(s); }
+    bool string(string_t& val) override { return value(val); }
+    bool binary(binary_t&) override { return false; }
+    bool start_object(std::size_t) override { return open(true); }
+    bool key(string_t& val) override
+    {
+        m_key = std::move(val);
+        return true;
+    }
+    bool end_object() override { return close(); }
+    bool start_array(std::size_t) override { return open(false); }
+    bool end_array() override { return close(); }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+    {
+        m_error = ex.what();
+        return false;
+    }
+
+    void parse(const std::string_view json, const char* shape)
+    {
+        if (!json::sax_parse(json.begin(), json.end(), this))
+        {
+            throw std::runtime_error(m_error.empty() ? std::string("unexpected JSON, expected ") + shape : m_error);
+        }
+    }
+
+protected:
+    int m_depth = 0;
+    std::string m_key;
+
+    virtual bool value(std::string_view text) = 0;
+    virtual bool nullValue() { return value({}); }
+    /// @return false if a container of this kind is not expected at the current depth
+    virtual bool open(bool object) = 0;
+
+private:
+    std::string m_error;
+
+    bool close()
+    {
+        --m_depth;
+        return true;
+    }
+};
+
+// ["a", "b", ...]
+class StringArraySax final : public ScalarSax
+{
+public:
+    explicit StringArraySax(const ZoteroJson::ValueCallback& onValue) : m_onValue(onValue) {}
+
+protected:
+    bool value(const std::string_view text) override
+    {
+        if (m_depth != 1)
+            return false;
+        m_onValue(text);
+        return true;
+    }
+    bool open(const bool object) override { return !object && m_depth++ == 0; }
+
+private:
+    const ZoteroJson::ValueCallback& m_onValue;
+};
+
+// {"field": "value", ...}
+class StringMapSax final : public ScalarSax
+{
+public:
+    explicit StringMapSax(const ZoteroJson::FieldCallback& onField) : m_onField(onField) {}
+
+protected:
+    bool value(const std::string_view text) override
+    {
+        if (m_depth != 1)
+            return false;
+        m_onField(m_key, text);
+        return true;
+    }
+    // an empty field is no field
+    bool nullValue() override { return m_depth == 1; }
+    bool open(const bool object) override { return object && m_depth++ == 0; }
+
+private:
+    const ZoteroJson::FieldCallback& m_onField;
+};
+
+// [{"key": ..., "path": ..., "contentType": ..., "title": ..., "url": ..., other fields}, ...]
+class AttachmentsSax final : public ScalarSax
+{
+public:
+    AttachmentsSax(const ZoteroJson::AttachmentCallback& onAttachment, const ZoteroJson::FieldCallback& onField)
+        : m_onAttachment(onAttachment), m_onField(onField) {}
+
+protected:
+    bool value(const std::string_view text) override
+    {
+        if (m_depth != 2)
+            return false;
+        m_onField(m_key, text);
+        return true;
+    }
+    bool open(const bool object) override
+    {
+        if (object != (m_depth == 1) || m_depth > 1)
+            return false;
+        if (object)
+            m_onAttachment();
+        ++m_depth;
+        return true;
+    }
+
+private:
+    const ZoteroJson::AttachmentCallback& m_onAttachment;
+    const ZoteroJson::FieldCallback& m_onField;
+};
+} // namespace
+
+
+void ZoteroJson::parseStringArray(const std::string_view json, const ValueCallback& onValue)
+{
+    StringArraySax sax(onValue);
+    sax.parse(json, "an array of strings");
+}
+
+void ZoteroJson::parseStringMap(const std::string_view json, const FieldCallback& onField)
+{
+    StringMapSax sax(onField);
+    sax.parse(json, "an object of strings");
+}
+
+void ZoteroJson::parseAttachments(const std::string_view json, const AttachmentCallback& onAttachment, const FieldCallback& onField)
+{
+    AttachmentsSax sax(onAttachment, onField);
+    sax.parse(json, "an array of attachments");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+
+/**
+ * Streaming decoders for the JSON aggregates of the Zotero item query.
+ *
+ * The query only produces a few fixed shapes (json_group_array of strings, json_group_object of
+ * field values and an array of attachment objects), so these decode the UTF-8 column bytes with a
+ * SAX parser and hand every value to a callback instead of building a DOM first. The views passed
+ * to the callbacks are only valid during the call. Scalars that are not strings (Zotero stores some
+ * field values as numbers) are converted to their textual form.
+ *
+ * All functions throw std::runtime_error on malformed or unexpectedly shaped input.
+ */
+namespace ZoteroJson
+{
+using ValueCallback = std::function<void(std::string_view value)>;
+using FieldCallback = std::function<void(std::string_view name, std::string_view value)>;
+using AttachmentCallback = std::function<void()>;
+
+void parseStringArray(std::string_view json, const ValueCallback& onValue);
+/// Null values are skipped
+void parseStringMap(std::string_view json, const FieldCallback& onField);
+/// @p onAttachment is called when an attachment starts, @p onField for each of its fields that follow
+void parseAttachments(std::string_view json, const AttachmentCallback& onAttachment, const FieldCallback& onField);
+} // namespace ZoteroJson